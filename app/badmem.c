@@ -0,0 +1,333 @@
+// SPDX-License-Identifier: GPL-2.0
+// Records the set of faulty pages found during a run and exports it in a
+// number of machine-readable formats, so that the faulty memory can be fenced
+// off without transcribing addresses from the screen:
+//
+//  - Linux memmap=size$addr kernel parameters
+//  - GRUB badram commands
+//  - a page-granular bitmap
+//  - a compact binary range list
+//
+// The exported text is written to the console stream, below the area used
+// for the screen display.
+
+#include "common.h"
+
+#include "memsize.h"
+#include "screen.h"
+
+#include "print.h"
+
+#include "badmem.h"
+#include "test.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MAX_RANGES      64
+
+#define LINE_SIZE       128
+
+#define GRUB_PAIRS      3       // addr,mask pairs per GRUB badram line
+
+#define BITMAP_PAGES    128     // pages per bitmap line (must be a power of 2)
+#define BITMAP_BYTES    (BITMAP_PAGES / 8)
+
+#define BINARY_BYTES    32      // bytes per binary list line
+#define BINARY_VERSION  1
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uintptr_t   start;          // first faulty page
+    uintptr_t   end;            // last faulty page + 1
+} range_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+// One spare entry is needed to hold a new range before the list is reduced.
+static range_t      ranges[MAX_RANGES + 1];
+static int          num_ranges = 0;
+
+static char         line[LINE_SIZE];
+static int          line_length = 0;
+
+static int          binary_count = 0;
+static uint16_t     fletcher_sum1 = 0;
+static uint16_t     fletcher_sum2 = 0;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void remove_range(int i)
+{
+    for (int j = i; j < num_ranges - 1; j++) {
+        ranges[j] = ranges[j + 1];
+    }
+    num_ranges--;
+}
+
+// When the list is full, merge the two ranges separated by the smallest gap.
+// This errs on the side of excluding some good pages rather than missing any
+// faulty ones.
+static void merge_closest_ranges(void)
+{
+    int       best_i   = 0;
+    uintptr_t best_gap = UINTPTR_MAX;
+    for (int i = 0; i < num_ranges - 1; i++) {
+        uintptr_t gap = ranges[i + 1].start - ranges[i].end;
+        if (gap < best_gap) {
+            best_gap = gap;
+            best_i   = i;
+        }
+    }
+    ranges[best_i].end = ranges[best_i + 1].end;
+    remove_range(best_i + 1);
+}
+
+static void append(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    line_length += vsprintk(&line[line_length], LINE_SIZE - line_length, fmt, args);
+    va_end(args);
+}
+
+static void append_hex64(uint64_t value)
+{
+    if (value >> 32) {
+        append("0x%x%08x", (uintptr_t)(value >> 32), (uintptr_t)(value & 0xFFFFFFFFU));
+    } else {
+        append("0x%x", (uintptr_t)value);
+    }
+}
+
+static void flush_line(void)
+{
+    if (line_length > 0) {
+        printf("%s\n", line);
+    }
+    line_length = 0;
+}
+
+static void export_memmap(void)
+{
+    for (int i = 0; i < num_ranges; i++) {
+        append("memmap=");
+        append_hex64((uint64_t)(ranges[i].end - ranges[i].start) << PAGE_SHIFT);
+        append("$");
+        append_hex64((uint64_t)ranges[i].start << PAGE_SHIFT);
+        flush_line();
+    }
+}
+
+static void export_grub(void)
+{
+    int pairs = 0;
+    for (int i = 0; i < num_ranges; i++) {
+        // Split the range into naturally aligned power-of-two blocks, each of
+        // which can be described by a single address/mask pair.
+        uint64_t page = ranges[i].start;
+        uint64_t end  = ranges[i].end;
+        while (page < end) {
+            uint64_t size = 1;
+            while ((page & ((size << 1) - 1)) == 0 && page + (size << 1) <= end) {
+                size <<= 1;
+            }
+            if (pairs == 0) {
+                append("badram ");
+            } else {
+                append(",");
+            }
+            append_hex64(page << PAGE_SHIFT);
+            append(",");
+            append_hex64(~((size << PAGE_SHIFT) - 1));
+            if (++pairs == GRUB_PAIRS) {
+                flush_line();
+                pairs = 0;
+            }
+            page += size;
+        }
+    }
+    flush_line();
+}
+
+static void export_bitmap(void)
+{
+    uintptr_t next_base = 0;
+    int i = 0;
+    while (i < num_ranges) {
+        uintptr_t base = ranges[i].start & ~(uintptr_t)(BITMAP_PAGES - 1);
+        if (base < next_base) {
+            base = next_base;
+        }
+        uintptr_t limit = base + BITMAP_PAGES;
+
+        uint8_t bits[BITMAP_BYTES];
+        memset(bits, 0, sizeof(bits));
+        for (int j = i; j < num_ranges && ranges[j].start < limit; j++) {
+            uintptr_t start = ranges[j].start > base  ? ranges[j].start : base;
+            uintptr_t end   = ranges[j].end   < limit ? ranges[j].end   : limit;
+            for (uintptr_t page = start; page < end; page++) {
+                bits[(page - base) / 8] |= 1 << ((page - base) % 8);
+            }
+        }
+        while (i < num_ranges && ranges[i].end <= limit) {
+            i++;
+        }
+        next_base = limit;
+
+        append("badpages %x ", base);
+        for (int j = 0; j < BITMAP_BYTES; j++) {
+            append("%02x", (uintptr_t)bits[j]);
+        }
+        flush_line();
+    }
+}
+
+static void emit_byte(uint8_t value)
+{
+    fletcher_sum1 = (fletcher_sum1 + value) % 255;
+    fletcher_sum2 = (fletcher_sum2 + fletcher_sum1) % 255;
+
+    if (binary_count % BINARY_BYTES == 0) {
+        flush_line();
+        append("badlist ");
+    }
+    append("%02x", (uintptr_t)value);
+    binary_count++;
+}
+
+static void emit_leb128(uint64_t value)
+{
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        emit_byte(byte);
+    } while (value != 0);
+}
+
+static void export_binary(void)
+{
+    binary_count  = 0;
+    fletcher_sum1 = 0;
+    fletcher_sum2 = 0;
+
+    emit_byte('B');
+    emit_byte('M');
+    emit_byte('E');
+    emit_byte('M');
+    emit_byte(BINARY_VERSION);
+    emit_leb128(num_ranges);
+    uintptr_t prev_end = 0;
+    for (int i = 0; i < num_ranges; i++) {
+        emit_leb128(ranges[i].start - prev_end);
+        emit_leb128(ranges[i].end - ranges[i].start);
+        prev_end = ranges[i].end;
+    }
+    uint16_t checksum = fletcher_sum2 << 8 | fletcher_sum1;
+    emit_byte(checksum >> 8);
+    emit_byte(checksum & 0xff);
+    flush_line();
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void badmem_init(void)
+{
+    num_ranges = 0;
+}
+
+bool badmem_insert(uintptr_t page)
+{
+    // Find the first range that contains the page, ends immediately before
+    // it, or starts after it.
+    int lo = 0;
+    int hi = num_ranges;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (ranges[mid].end < page) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int i = lo;
+
+    if (i < num_ranges) {
+        if (ranges[i].start <= page && page < ranges[i].end) {
+            return false;
+        }
+        if (ranges[i].end == page) {
+            ranges[i].end++;
+            if (i + 1 < num_ranges && ranges[i + 1].start == ranges[i].end) {
+                ranges[i].end = ranges[i + 1].end;
+                remove_range(i + 1);
+            }
+            return true;
+        }
+        if (ranges[i].start == page + 1) {
+            ranges[i].start = page;
+            return true;
+        }
+    }
+
+    for (int j = num_ranges; j > i; j--) {
+        ranges[j] = ranges[j - 1];
+    }
+    ranges[i].start = page;
+    ranges[i].end   = page + 1;
+    num_ranges++;
+
+    if (num_ranges > MAX_RANGES) {
+        merge_closest_ranges();
+    }
+    return true;
+}
+
+int badmem_num_ranges(void)
+{
+    return num_ranges;
+}
+
+void badmem_export(int formats)
+{
+    uintptr_t num_pages = 0;
+    for (int i = 0; i < num_ranges; i++) {
+        num_pages += ranges[i].end - ranges[i].start;
+    }
+
+    // Move the cursor below the screen display area.
+    printf("\033[%d;1H\n", SCREEN_HEIGHT + 1);
+
+    append("badmem pass %i ranges %i pages %u", pass_num, num_ranges, num_pages);
+    flush_line();
+
+    if (formats & EXPORT_MEMMAP) {
+        export_memmap();
+    }
+    if (formats & EXPORT_GRUB) {
+        export_grub();
+    }
+    if (formats & EXPORT_BITMAP) {
+        export_bitmap();
+    }
+    if (formats & EXPORT_BINARY) {
+        export_binary();
+    }
+
+    append("badmem end");
+    flush_line();
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef BADMEM_H
+#define BADMEM_H
+/**
+ * \file
+ *
+ * Provides functions for recording the set of faulty pages and exporting
+ * it in formats that can be used to exclude those pages from use.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The export formats. These may be combined.
+ */
+#define EXPORT_MEMMAP   0x01    // Linux memmap=size$addr kernel parameters
+#define EXPORT_GRUB     0x02    // GRUB badram command
+#define EXPORT_BITMAP   0x04    // page-granular bitmap
+#define EXPORT_BINARY   0x08    // compact binary range list, hex encoded
+
+#define EXPORT_ALL      0x0f
+
+/**
+ * Clears the set of faulty pages.
+ */
+void badmem_init(void);
+
+/**
+ * Inserts a faulty page into the set. Returns true iff the set was changed.
+ */
+bool badmem_insert(uintptr_t page);
+
+/**
+ * Returns the number of page ranges in the set.
+ */
+int badmem_num_ranges(void);
+
+/**
+ * Writes the set of faulty pages to the console stream in each of the
+ * requested formats.
+ */
+void badmem_export(int formats);
+
+#endif // BADMEM_H
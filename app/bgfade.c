@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: GPL-2.0
+// Runs the bit fade test in the background. At the start of each pass, one
+// slice of the tested memory is reserved as the fade region and filled with
+// all zeros. The other tests skip the fade region. Whenever a test completes,
+// the fade timer is checked, and once it has expired the region is checked
+// and refilled with all ones, and then checked again after a second delay.
+// Any delay still outstanding at the end of the pass is waited for there.
+//
+// The fade region is taken from all the memory within the test limits and is
+// rotated through the slices on successive passes, so the whole of that memory
+// is fade tested after BGFADE_SLICES passes. The region may lie in or span any
+// of the memory windows, so each window it covers is mapped in turn when it is
+// filled or checked.
+
+#include "common.h"
+#include "unistd.h"
+
+#include "cache.h"
+#include "pmem.h"
+#include "vmem.h"
+
+#include "config.h"
+#include "display.h"
+#include "error.h"
+#include "test.h"
+#include "tests.h"
+
+#include "bgfade.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define BGFADE_SLICES       8
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef enum {
+    FADE_IDLE,
+    FADE_ZEROS,
+    FADE_ONES
+} fade_stage_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static fade_stage_t     fade_stage = FADE_IDLE;
+
+static uintptr_t        region_start = 0;
+static uintptr_t        region_end   = 0;
+
+static uint64_t         fade_time_us = 0;
+static uint64_t         deadline     = 0;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void clip_segment(int i, uintptr_t *start, uintptr_t *end)
+{
+    *start = (pm_map[i].start > pm_limit_lower) ? pm_map[i].start : pm_limit_lower;
+    *end   = (pm_map[i].end   < pm_limit_upper) ? pm_map[i].end   : pm_limit_upper;
+}
+
+static void choose_region(int pass)
+{
+    uintptr_t total_pages = 0;
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t start, end;
+        clip_segment(i, &start, &end);
+        if (start < end) {
+            total_pages += end - start;
+        }
+    }
+
+    region_start = 0;
+    region_end   = 0;
+
+    uintptr_t slice_pages = total_pages / BGFADE_SLICES;
+    if (slice_pages == 0) {
+        return;
+    }
+    uintptr_t n = (pass % BGFADE_SLICES) * slice_pages;
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t start, end;
+        clip_segment(i, &start, &end);
+        if (start >= end) {
+            continue;
+        }
+        if (n < end - start) {
+            // The region doesn't extend beyond the segment.
+            region_start = start + n;
+            region_end   = (end - region_start > slice_pages) ? region_start + slice_pages : end;
+            return;
+        }
+        n -= end - start;
+    }
+}
+
+static bool map_part(uintptr_t start, uintptr_t *end)
+{
+    // Limit the part to the window containing its start.
+    uintptr_t window_end = (start / VM_WINDOW_SIZE + 1) * VM_WINDOW_SIZE;
+    *end = (region_end < window_end) ? region_end : window_end;
+    return map_window(start);
+}
+
+static void region_fill(testword_t pattern)
+{
+    uintptr_t start = region_start;
+    uintptr_t end;
+    while (start < region_end && map_part(start, &end)) {
+        testword_t *p  = first_word_mapping(start);
+        testword_t *pe = last_word_mapping(end - 1, sizeof(testword_t));
+        do {
+            write_word(p, pattern);
+        } while (p++ < pe);
+        start = end;
+    }
+
+    cache_flush();
+
+    deadline = get_time_us() + fade_time_us;
+}
+
+static void region_check(testword_t pattern)
+{
+    // Attribute any errors to the bit fade test.
+    int saved_test_num = test_num;
+    test_num = BIT_FADE_TEST;
+
+    uintptr_t start = region_start;
+    uintptr_t end;
+    while (start < region_end && map_part(start, &end)) {
+        testword_t *p  = first_word_mapping(start);
+        testword_t *pe = last_word_mapping(end - 1, sizeof(testword_t));
+        do {
+            testword_t actual = read_word(p);
+            if (unlikely(actual != pattern)) {
+                data_error(p, pattern, actual, true);
+            }
+        } while (p++ < pe);
+        start = end;
+    }
+
+    test_num = saved_test_num;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+bool bgfade_region(uintptr_t *start, uintptr_t *end)
+{
+    if (fade_stage == FADE_IDLE) {
+        return false;
+    }
+    *start = region_start;
+    *end   = region_end;
+    return true;
+}
+
+void bgfade_start_pass(int pass, int fade_secs)
+{
+    fade_stage = FADE_IDLE;
+
+    choose_region(pass);
+    if (region_start == region_end) {
+        return;
+    }
+
+    fade_time_us = (uint64_t)fade_secs * 1000000;
+    region_fill(0);
+    fade_stage = FADE_ZEROS;
+}
+
+void bgfade_poll(bool wait)
+{
+    bool waiting = false;
+    while (fade_stage != FADE_IDLE) {
+        uint64_t now = get_time_us();
+        if (now < deadline) {
+            if (!wait) {
+                return;
+            }
+            if (!waiting) {
+                display_test_number(BIT_FADE_TEST);
+                display_test_description(test_list[BIT_FADE_TEST].description);
+                waiting = true;
+            }
+            uint64_t remaining = deadline - now;
+            display_test_stage_description("background fade, %i seconds left",
+                                           (int)((remaining + 999999) / 1000000));
+            usleep(remaining < 1000000 ? remaining : 1000000);
+            continue;
+        }
+        if (fade_stage == FADE_ZEROS) {
+            region_check(0);
+            region_fill(~(testword_t)0);
+            fade_stage = FADE_ONES;
+        } else {
+            region_check(~(testword_t)0);
+            fade_stage = FADE_IDLE;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef BGFADE_H
+#define BGFADE_H
+/**
+ * \file
+ *
+ * Provides a background version of the bit fade test, where a region of
+ * memory is left to fade while the other tests run on the rest of memory.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Returns true if a fade region has been reserved for the current pass, and
+ * if so, stores its first page and last page + 1 in *start and *end.
+ */
+bool bgfade_region(uintptr_t *start, uintptr_t *end);
+
+/**
+ * Chooses the fade region for the specified pass, fills it with the first
+ * pattern, and starts the fade timer. The region is rotated through the
+ * tested memory on successive passes.
+ */
+void bgfade_start_pass(int pass, int fade_secs);
+
+/**
+ * Checks the fade region if the fade timer has expired, and if so, starts
+ * the next pattern or releases the region. If wait is true, first waits for
+ * the timer, and continues until the region is released. Must only be called
+ * by the master CPU when all other CPUs are idle.
+ */
+void bgfade_poll(bool wait);
+
+#endif // BGFADE_H
@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-2.0
+// Saves the position reached in a run, together with the error counts, in a
+// compact checkpoint record. When the checkpoint boot option is given, the
+// record is written to a page of memory that is excluded from testing, so
+// that it survives a warm restart, and is also written to the console stream
+// as a line of the form
+//
+//      checkpoint <hex>
+//
+// from which it can be passed back to the next boot with the resume=<hex>
+// boot option. The record in memory is cleared when the program exits, so
+// that only an interrupted run is resumed. Otherwise the page is tested as
+// usual, and any record found in it is ignored.
+//
+// The record is stored as little-endian bytes:
+//
+//      0   magic "MTCP"
+//      4   version
+//      5   number of tests (N)
+//      6   pass number (16 bits)
+//      8   test number
+//      9   test stage
+//     10   window number (16 bits)
+//     12   error count (32 bits, saturating)
+//     16   lowest error address (64 bits)
+//     24   highest error address (64 bits)
+//     32   bits in error mask (64 bits)
+//     40   total bits in error (64 bits)
+//     48   max contiguous errors (32 bits, saturating)
+//     52   min bits in error
+//     53   max bits in error
+//     54   unused (16 bits)
+//     56   error count for each test (N x 32 bits)
+//   56+4N  test number at each position in the pass order (N bytes)
+//   56+5N  Fletcher-32 checksum of the preceding bytes
+//
+// The summary statistics are only meaningful if the error count is non-zero.
+
+#include "common.h"
+
+#include "memsize.h"
+#include "pmem.h"
+#include "screen.h"
+#include "vmem.h"
+
+#include "print.h"
+
+#include "checkpoint.h"
+#include "config.h"
+#include "error.h"
+#include "tests.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define CHECKPOINT_VERSION  3
+
+#define HEADER_SIZE         56
+#define ORDER_OFFSET        (HEADER_SIZE + 4 * NUM_TEST_PATTERNS)
+#define RECORD_SIZE         (ORDER_OFFSET + NUM_TEST_PATTERNS + 4)
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static int          record_segment = -1;
+static uintptr_t    record_page    = 0;
+
+static uint8_t      *saved_record = NULL;
+
+static uint8_t      loaded_record[RECORD_SIZE];
+static bool         loaded = false;
+static bool         loaded_from_memory = false;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void put16(uint8_t *buffer, int offset, uint32_t value)
+{
+    buffer[offset + 0] = value;
+    buffer[offset + 1] = value >> 8;
+}
+
+static void put32(uint8_t *buffer, int offset, uint32_t value)
+{
+    put16(buffer, offset + 0, value);
+    put16(buffer, offset + 2, value >> 16);
+}
+
+static void put64(uint8_t *buffer, int offset, uint64_t value)
+{
+    put32(buffer, offset + 0, value);
+    put32(buffer, offset + 4, value >> 32);
+}
+
+static uint32_t get16(const uint8_t *buffer, int offset)
+{
+    return buffer[offset] | (uint32_t)buffer[offset + 1] << 8;
+}
+
+static uint32_t get32(const uint8_t *buffer, int offset)
+{
+    return get16(buffer, offset) | get16(buffer, offset + 2) << 16;
+}
+
+static uint64_t get64(const uint8_t *buffer, int offset)
+{
+    return get32(buffer, offset) | (uint64_t)get32(buffer, offset + 4) << 32;
+}
+
+static uint32_t checksum(const uint8_t *buffer, int length)
+{
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+    for (int i = 0; i < length; i++) {
+        sum1 = (sum1 + buffer[i]) % 65535;
+        sum2 = (sum2 + sum1) % 65535;
+    }
+    return sum2 << 16 | sum1;
+}
+
+static bool record_is_valid(const uint8_t *record)
+{
+    return record[0] == 'M' && record[1] == 'T' && record[2] == 'C' && record[3] == 'P'
+        && record[4] == CHECKPOINT_VERSION
+        && record[5] == NUM_TEST_PATTERNS
+        && get32(record, RECORD_SIZE - 4) == checksum(record, RECORD_SIZE - 4);
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void checkpoint_init(void)
+{
+    // Use the last page of the highest segment that is directly mapped, or
+    // failing that, the first page of the lowest segment.
+    record_segment = -1;
+    for (int i = 0; i < pm_map_size; i++) {
+        if (pm_map[i].end <= VM_PINNED_SIZE && pm_map[i].end > pm_map[i].start) {
+            record_segment = i;
+        }
+    }
+    if (record_segment >= 0) {
+        record_page = pm_map[record_segment].end - 1;
+    } else if (pm_map_size > 0 && pm_map[0].start < VM_PINNED_SIZE) {
+        record_page = pm_map[0].start;
+    } else {
+        return;
+    }
+
+    const uint8_t *record = (const uint8_t *)first_word_mapping(record_page);
+    if (record_is_valid(record)) {
+        memcpy(loaded_record, record, RECORD_SIZE);
+        loaded = true;
+        loaded_from_memory = true;
+    }
+}
+
+void checkpoint_reserve(void)
+{
+    if (!enable_checkpoint) {
+        // Ignore any record left in memory, and leave the page to be tested.
+        if (loaded_from_memory) {
+            loaded = false;
+        }
+        return;
+    }
+    if (record_segment >= 0) {
+        pm_map[record_segment].end--;
+    } else if (pm_map_size > 0 && pm_map[0].start < VM_PINNED_SIZE) {
+        pm_map[0].start++;
+    } else {
+        return;
+    }
+    num_pm_pages--;
+
+    saved_record = (uint8_t *)first_word_mapping(record_page);
+}
+
+void checkpoint_load(const char *hex)
+{
+    uint8_t record[RECORD_SIZE];
+
+    if (hex == NULL) {
+        return;
+    }
+    for (int i = 0; i < RECORD_SIZE; i++) {
+        int hi = hex_digit(hex[2 * i]);
+        int lo = (hi < 0) ? -1 : hex_digit(hex[2 * i + 1]);
+        if (lo < 0) {
+            return;
+        }
+        record[i] = hi << 4 | lo;
+    }
+    if (record_is_valid(record)) {
+        memcpy(loaded_record, record, RECORD_SIZE);
+        loaded = true;
+        loaded_from_memory = false;
+    }
+}
+
+void checkpoint_discard(void)
+{
+    loaded = false;
+}
+
+void checkpoint_clear(void)
+{
+    if (saved_record != NULL) {
+        memset(saved_record, 0, RECORD_SIZE);
+    }
+}
+
+bool checkpoint_restore(run_position_t *position)
+{
+    if (!loaded) {
+        return false;
+    }
+    loaded = false;
+
+    position->pass_num   = get16(loaded_record, 6);
+    position->test_num   = loaded_record[8];
+    position->test_stage = loaded_record[9];
+    position->window_num = get16(loaded_record, 10);
+    if (position->test_num >= NUM_TEST_PATTERNS
+    ||  position->test_stage >= test_list[position->test_num].stages) {
+        return false;
+    }
+    bool used[NUM_TEST_PATTERNS];
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        used[i] = false;
+    }
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        int test = loaded_record[ORDER_OFFSET + i];
+        if (test >= NUM_TEST_PATTERNS || used[test]) {
+            return false;
+        }
+        used[test] = true;
+        position->test_order[i] = test;
+    }
+
+    error_summary_t summary;
+    summary.min_addr   = get64(loaded_record, 16);
+    summary.max_addr   = get64(loaded_record, 24);
+    summary.bad_bits   = get64(loaded_record, 32);
+    summary.total_bits = get64(loaded_record, 40);
+    summary.max_run    = get32(loaded_record, 48);
+    summary.min_bits   = loaded_record[52];
+    summary.max_bits   = loaded_record[53];
+    error_restore(get32(loaded_record, 12), &summary);
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        test_list[i].errors = get32(loaded_record, HEADER_SIZE + 4 * i);
+    }
+    return true;
+}
+
+void checkpoint_save(const run_position_t *position, bool to_console)
+{
+    uint8_t record[RECORD_SIZE];
+
+    record[0] = 'M';
+    record[1] = 'T';
+    record[2] = 'C';
+    record[3] = 'P';
+    record[4] = CHECKPOINT_VERSION;
+    record[5] = NUM_TEST_PATTERNS;
+    put16(record, 6, position->pass_num);
+    record[8] = position->test_num;
+    record[9] = position->test_stage;
+    put16(record, 10, position->window_num);
+    put32(record, 12, error_count < UINT32_MAX ? error_count : UINT32_MAX);
+
+    error_summary_t summary;
+    error_get_summary(&summary);
+    put64(record, 16, summary.min_addr);
+    put64(record, 24, summary.max_addr);
+    put64(record, 32, summary.bad_bits);
+    put64(record, 40, summary.total_bits);
+    put32(record, 48, summary.max_run < UINT32_MAX ? summary.max_run : UINT32_MAX);
+    record[52] = summary.min_bits;
+    record[53] = summary.max_bits;
+    put16(record, 54, 0);
+
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        put32(record, HEADER_SIZE + 4 * i, test_list[i].errors);
+    }
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        record[ORDER_OFFSET + i] = position->test_order[i];
+    }
+    put32(record, RECORD_SIZE - 4, checksum(record, RECORD_SIZE - 4));
+
+    if (saved_record != NULL) {
+        memcpy(saved_record, record, RECORD_SIZE);
+    }
+
+    if (to_console) {
+        char line[2 * RECORD_SIZE + 1];
+        for (int i = 0; i < RECORD_SIZE; i++) {
+            sprintk(&line[2 * i], 3, "%02x", (uintptr_t)record[i]);
+        }
+        printf("\033[%d;1H\ncheckpoint %s\n", SCREEN_HEIGHT + 1, line);
+    }
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+/**
+ * \file
+ *
+ * Provides functions for saving the position reached in a run, so that an
+ * interrupted run can be resumed after a restart.
+ */
+
+#include <stdbool.h>
+
+#include "tests.h"
+
+/**
+ * A position in the run, including the order in which the tests are run in
+ * the current pass.
+ */
+typedef struct {
+    int     pass_num;
+    int     test_num;
+    int     test_stage;
+    int     window_num;
+    int     test_order[NUM_TEST_PATTERNS];
+} run_position_t;
+
+/**
+ * Chooses the page of physical memory to hold the checkpoint record, and
+ * loads any valid record left in it by a previous boot. Must be called
+ * before anything else writes to the physical memory.
+ */
+void checkpoint_init(void);
+
+/**
+ * If the checkpoint option is enabled, reserves the page chosen by
+ * checkpoint_init. Otherwise discards any record loaded from that page.
+ * Must be called after the command line has been parsed and before anything
+ * else reserves pages in the physical memory map.
+ */
+void checkpoint_reserve(void);
+
+/**
+ * Loads the checkpoint record from a hexadecimal string, as written to the
+ * console stream. Overrides any record found in memory.
+ */
+void checkpoint_load(const char *hex);
+
+/**
+ * Discards any loaded checkpoint record.
+ */
+void checkpoint_discard(void);
+
+/**
+ * If a valid checkpoint record has been loaded, restores the error counts,
+ * returns the saved position, and returns true. Otherwise returns false.
+ * Only returns true once.
+ */
+bool checkpoint_restore(run_position_t *position);
+
+/**
+ * Invalidates the record in the reserved memory page. Called when the program
+ * exits, so that the next boot starts a new run.
+ */
+void checkpoint_clear(void);
+
+/**
+ * Saves the position and the current error counts in the reserved memory
+ * page, and also writes it to the console stream if to_console is set.
+ */
+void checkpoint_save(const run_position_t *position, bool to_console);
+
+#endif // CHECKPOINT_H
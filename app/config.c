@@ -16,6 +16,8 @@
 #include "vmem.h"
 #include "read.h"
 #include "unistd.h"
+#include "badmem.h"
+#include "checkpoint.h"
 #include "display.h"
 #include "tests.h"
 
@@ -65,7 +67,11 @@ error_mode_t    error_mode = ERROR_MODE_NONE;
 
 bool            exclude_ecores     = true;
 
+#if defined(__ARCH_NATIVE)
+bool            smp_enabled        = true;              // One process per CPU (see the "smp" environment variable)
+#else
 bool            smp_enabled        = false;
+#endif
 
 bool            enable_big_status  = true;
 bool            enable_temperature = true;
@@ -92,6 +98,25 @@ int             tty_mmio_stride    = 4;                 // Stride for MMIO (regi
 
 bool            err_banner_redraw  = false;             // Redraw banner on new errors
 
+int             export_formats     = 0;                 // Bad page export formats (none by default)
+
+bool            enable_retest      = true;              // Retest failing lines at the end of each test
+
+uint32_t        time_budget        = 0;                 // Run time limit in seconds (0 = unlimited)
+
+bool            enable_checkpoint  = false;             // Keep checkpoints in memory and on the console
+
+int             sample_percent     = 0;                 // Percentage of memory tested per pass (0 = all)
+
+bool            enable_adaptive    = false;             // Concentrate testing near failing pages
+
+bool            enable_test_order  = true;              // Run the highest yield tests first
+
+bool            enable_bgfade      = false;             // Run the bit fade test in the background
+
+int             os_mem_percent     = 90;                // Percentage of free memory to test when running as an OS process
+uint64_t        os_mem_size        = 0;                 // Bytes of memory to test when running as an OS process (0 = use percentage)
+
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
@@ -176,12 +201,139 @@ static void parse_serial_params(const char *params)
 
 }
 
+static void parse_export_params(const char *params)
+{
+    export_formats = 0;
+
+    // No parameters passed (only "export"), use all formats
+    if (params == NULL) {
+        export_formats = EXPORT_ALL;
+        return;
+    }
+
+    while (*params != '\0') {
+        if (strncmp(params, "memmap", 6) == 0) {
+            export_formats |= EXPORT_MEMMAP;
+        } else if (strncmp(params, "grub", 4) == 0) {
+            export_formats |= EXPORT_GRUB;
+        } else if (strncmp(params, "bitmap", 6) == 0) {
+            export_formats |= EXPORT_BITMAP;
+        } else if (strncmp(params, "binary", 6) == 0) {
+            export_formats |= EXPORT_BINARY;
+        } else if (strncmp(params, "all", 3) == 0) {
+            export_formats |= EXPORT_ALL;
+        }
+        while (*params != '\0' && *params != ',') {
+            params++;
+        }
+        if (*params == ',') {
+            params++;
+        }
+    }
+}
+
+static void parse_budget_params(const char *params)
+{
+    if (params == NULL) {
+        return;
+    }
+
+    uint32_t value = 0;
+    while (*params >= '0' && *params <= '9') {
+        value = 10 * value + (*params++ - '0');
+    }
+
+    // The default unit is minutes.
+    switch (*params) {
+      case 'h':
+        value *= 3600;
+        break;
+      case 's':
+        break;
+      default:
+        value *= 60;
+        break;
+    }
+    time_budget = value;
+}
+
+static void parse_sample_params(const char *params)
+{
+    if (params == NULL) {
+        return;
+    }
+    int value = 0;
+    while (*params >= '0' && *params <= '9' && value < 100) {
+        value = 10 * value + (*params++ - '0');
+    }
+    sample_percent = (value < 100) ? value : 0;
+}
+
+static void parse_copytime_params(const char *params)
+{
+    if (params == NULL) {
+        return;
+    }
+    int value = 0;
+    while (*params >= '0' && *params <= '9' && value < 100000) {
+        value = 10 * value + (*params++ - '0');
+    }
+    if (value > 0) {
+        test_list[COPY_TEST].iterations = value;
+    }
+}
+
+static void parse_osmem_params(const char *params)
+{
+    if (params == NULL) {
+        return;
+    }
+    uint64_t value = 0;
+    while (*params >= '0' && *params <= '9' && value < 0x100000000) {
+        value = 10 * value + (*params++ - '0');
+    }
+
+    // The default unit is megabytes.
+    switch (*params) {
+      case '%':
+        if (value > 0 && value <= 100) {
+            os_mem_percent = value;
+            os_mem_size    = 0;
+        }
+        return;
+      case 'G':
+      case 'g':
+        value <<= 30;
+        break;
+      case 'K':
+      case 'k':
+        value <<= 10;
+        break;
+      default:
+        value <<= 20;
+        break;
+    }
+    if (value > 0) {
+        os_mem_size = value;
+    }
+}
+
 static void parse_option(const char *option, const char *params)
 {
     if (option[0] == '\0') return;
 
-    if (strncmp(option, "console", 8) == 0) {
+    if (strncmp(option, "adaptive", 9) == 0) {
+        enable_adaptive = true;
+    } else if (strncmp(option, "bgfade", 7) == 0) {
+        enable_bgfade = true;
+    } else if (strncmp(option, "budget", 7) == 0) {
+        parse_budget_params(params);
+    } else if (strncmp(option, "checkpoint", 11) == 0) {
+        enable_checkpoint = true;
+    } else if (strncmp(option, "console", 8) == 0) {
         parse_serial_params(params);
+    } else if (strncmp(option, "copytime", 9) == 0) {
+        parse_copytime_params(params);
     } else if (strncmp(option, "cpuseqmode", 11) == 0) {
         if (strncmp(params, "par", 4) == 0) {
             cpu_mode = PAR;
@@ -199,7 +351,15 @@ static void parse_option(const char *option, const char *params)
             error_mode = ERROR_MODE_ADDRESS;
         } else if (strncmp(params, "badram", 7) == 0) {
             error_mode = ERROR_MODE_BADRAM;
+        } else if (strncmp(params, "heatmap", 8) == 0) {
+            error_mode = ERROR_MODE_HEATMAP;
         }
+    } else if (strncmp(option, "export", 7) == 0) {
+        parse_export_params(params);
+    } else if (strncmp(option, "fixedorder", 11) == 0) {
+        enable_test_order = false;
+    } else if (strncmp(option, "march", 6) == 0) {
+        march_select(params);
     } else if (strncmp(option, "nobench", 8) == 0) {
         enable_bench = false;
     } else if (strncmp(option, "nobigstatus", 12) == 0) {
@@ -210,12 +370,18 @@ static void parse_option(const char *option, const char *params)
         pause_at_start = false;
     } else if (strncmp(option, "nosm", 5) == 0) {
         enable_sm = false;
+    } else if (strncmp(option, "noresume", 9) == 0) {
+        checkpoint_discard();
+    } else if (strncmp(option, "noretest", 9) == 0) {
+        enable_retest = false;
     } else if (strncmp(option, "nosmp", 6) == 0) {
         smp_enabled = false;
     } else if (strncmp(option, "numa", 5) == 0) {
         enable_numa = true;
     } else if (strncmp(option, "nonuma", 7) == 0) {
         enable_numa = false;
+    } else if (strncmp(option, "osmem", 6) == 0) {
+        // Already handled by parse_early_options().
     } else if (strncmp(option, "powersave", 10) == 0) {
         if (strncmp(params, "off", 4) == 0) {
             power_save = POWER_SAVE_OFF;
@@ -224,6 +390,10 @@ static void parse_option(const char *option, const char *params)
         } else if (strncmp(params, "high", 5) == 0) {
             power_save = POWER_SAVE_HIGH;
         }
+    } else if (strncmp(option, "resume", 7) == 0) {
+        checkpoint_load(params);
+    } else if (strncmp(option, "sample", 7) == 0) {
+        parse_sample_params(params);
     } else if (strncmp(option, "trace", 6) == 0) {
         enable_trace = true;
     }
@@ -254,6 +424,21 @@ void parse_command_line(char *cmd_line, int cmd_line_size)
     }
 }
 
+void parse_early_options(const char *cmd_line)
+{
+    while (*cmd_line != '\0') {
+        if (strncmp(cmd_line, "osmem=", 6) == 0) {
+            parse_osmem_params(cmd_line + 6);
+        }
+        while (*cmd_line != '\0' && *cmd_line != ' ') {
+            cmd_line++;
+        }
+        while (*cmd_line == ' ') {
+            cmd_line++;
+        }
+    }
+}
+
 static void update_num_pages_to_test(void)
 {
     num_pages_to_test = 0;
@@ -599,7 +784,8 @@ static void error_mode_menu(void)
     prints(POP_R+4, POP_LI, "<F2>  Error summary");
     prints(POP_R+5, POP_LI, "<F3>  Individual errors");
     prints(POP_R+6, POP_LI, "<F4>  BadRAM patterns");
-    prints(POP_R+7, POP_LI, "<F10> Exit menu");
+    prints(POP_R+7, POP_LI, "<F5>  Error heatmap");
+    prints(POP_R+8, POP_LI, "<F10> Exit menu");
     printc(POP_R+3+error_mode, POP_LM, '*');
 
     bool tty_update = enable_tty;
@@ -618,6 +804,7 @@ static void error_mode_menu(void)
           case '2':
           case '3':
           case '4':
+          case '5':
             set_error_mode(ch - '1');
             break;
           case 'u':
@@ -626,7 +813,7 @@ static void error_mode_menu(void)
             }
             break;
           case 'd':
-            if (error_mode < 3) {
+            if (error_mode < ERROR_MODE_HEATMAP) {
                 set_error_mode(error_mode + 1);
             }
             break;
@@ -760,6 +947,7 @@ void initial_config(void)
               case ESC:
                 clear_message_area();
                 display_notice("Exiting...");
+                checkpoint_clear();
                 halt(0);
                 break;
               case '1':
@@ -25,7 +25,8 @@ typedef enum {
     ERROR_MODE_NONE,
     ERROR_MODE_SUMMARY,
     ERROR_MODE_ADDRESS,
-    ERROR_MODE_BADRAM
+    ERROR_MODE_BADRAM,
+    ERROR_MODE_HEATMAP
 } error_mode_t;
 
 typedef enum {
@@ -71,8 +72,35 @@ extern int          tty_mmio_stride;
 
 extern bool err_banner_redraw;
 
+extern int          export_formats;
+
+extern bool         enable_retest;
+
+extern uint32_t     time_budget;
+
+extern bool         enable_checkpoint;
+
+extern int          sample_percent;
+
+extern bool         enable_adaptive;
+
+extern bool         enable_test_order;
+
+extern bool         enable_bgfade;
+
+extern int          os_mem_percent;
+extern uint64_t     os_mem_size;
+
 void config_init(void);
 
+void parse_command_line(char *cmd_line, int cmd_line_size);
+
+/**
+ * Parses the options that must be known before the memory map is built.
+ * Unlike parse_command_line(), cmd_line is not modified.
+ */
+void parse_early_options(const char *cmd_line);
+
 void config_menu(bool initial);
 
 void initial_config(void);
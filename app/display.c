@@ -6,8 +6,11 @@
 
 #include "cpuinfo.h"
 #include "serial.h"
+#include "checkpoint.h"
 #include "error.h"
+#include "planner.h"
 #include "tests.h"
+#include "trace.h"
 #include "display.h"
 
 //------------------------------------------------------------------------------
@@ -181,7 +184,7 @@ void post_display_init(void)
 
 void display_start_run(void)
 {
-    if (!enable_trace && !enable_sm) {
+    if (!enable_sm) {
         clear_message_area();
     }
 
@@ -299,11 +302,17 @@ void check_input(void)
       case ESC:
         clear_message_area();
         display_notice("Exiting...");
+        checkpoint_clear();
         halt(0);
         break;
       case '1':
         config_menu(false);
         break;
+      case 't':
+        if (enable_trace) {
+            trace_dump();
+        }
+        break;
       case ' ':
         set_scroll_lock(!scroll_lock);
         break;
@@ -360,6 +369,9 @@ void do_tick(int my_cpu)
     if (master_cpu == my_cpu) {
         check_input();
         error_update();
+        if (planner_expired()) {
+            bail = true;
+        }
     }
     if (use_spin_wait) {
         barrier_spin_wait(run_barrier);
@@ -446,15 +458,3 @@ void do_tick(int my_cpu)
     }
 }
 
-void do_trace(int my_cpu, const char *fmt, ...)
-{
-    va_list args;
-
-    va_start(args, fmt);
-    spin_lock(error_mutex);
-    scroll();
-    printi(scroll_message_row, 0, my_cpu, 2, false, false);
-    vprintf(scroll_message_row, 4, fmt, args);
-    spin_unlock(error_mutex);
-    va_end(args);
-}
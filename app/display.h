@@ -227,9 +227,6 @@ typedef enum {
         set_foreground_colour(WHITE); \
     }
 
-#define trace(my_cpu, ...) \
-    if (enable_trace) do_trace(my_cpu, __VA_ARGS__)
-
 #define display_msr_failed_flag() \
     printc(0, SCREEN_WIDTH - 1, '*');
 
@@ -265,6 +262,4 @@ void scroll(void);
 
 void do_tick(int my_cpu);
 
-void do_trace(int my_cpu, const char *fmt, ...);
-
 #endif // DISPLAY_H
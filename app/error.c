@@ -12,11 +12,65 @@
 #include <limits.h>
 
 #include "vmem.h"
+#ifdef FAULT_SIM
+#include "faultsim.h"
+#endif
+#include "badmem.h"
 #include "badram.h"
 #include "display.h"
+#include "error.h"
+#include "retest.h"
 #include "tests.h"
 #include "serial.h"
 
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+// The failing page map is a two-level sparse bitmap. The directory has one
+// entry per leaf-sized chunk of the physical address space, which is either
+// empty, an index into the leaf pool, or marks the chunk as saturated when
+// the pool has been exhausted.
+
+#define LEAF_SHIFT          15                      // 128MB per leaf
+#define LEAF_PAGES          (1 << LEAF_SHIFT)
+#define LEAF_WORDS          (LEAF_PAGES / 32)
+
+#define MAX_LEAVES          32
+#define DIR_SIZE            8192                    // covers 1TB
+
+#define LEAF_NONE           0
+#define LEAF_SATURATED      UINT16_MAX
+
+#define GB_SHIFT            (30 - PAGE_SHIFT)       // pages per GB
+#define MAX_GB              ((DIR_SIZE << LEAF_SHIFT) >> GB_SHIFT)
+
+// Heatmap layout within the message area.
+
+#define HEAT_LEVELS         10
+#define HEAT_COLS           64
+#define HEAT_ROWS           5
+
+// In address mode, errors are folded into groups that are displayed at the
+// next screen update. Errors that don't fit are counted but not displayed.
+
+#define MAX_ERROR_GROUPS    8
+
+// Flags for the error summary statistics that need to be redisplayed.
+
+#define STAT_MIN_ADDR       0x01
+#define STAT_MAX_ADDR       0x02
+#define STAT_BAD_BITS       0x04
+#define STAT_NUM_BITS       0x08
+#define STAT_MAX_RUN        0x10
+
+#define STAT_ALL            0x1f
+
+// The test error counts are listed down the right hand side of the message
+// area, continuing in a second column below the statistics if necessary.
+#define SUMMARY_ROWS        (ROW_MESSAGE_B - ROW_MESSAGE_T)
+#define SUMMARY_ROW2        7
+
 //------------------------------------------------------------------------------
 // Types
 //------------------------------------------------------------------------------
@@ -47,6 +101,22 @@ typedef struct {
     testword_t          last_xor;
 } error_info_t;
 
+typedef struct {
+    bool                parity;
+    int                 cpu;
+    int                 pass;
+    int                 test;
+    int                 number;
+    page_offs_t         first;
+    page_offs_t         last;
+    uintptr_t           last_addr;
+    intptr_t            stride;
+    uintptr_t           count;
+    testword_t          good;
+    testword_t          bad;
+    testword_t          xor;
+} error_group_t;
+
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
@@ -55,6 +125,42 @@ static error_mode_t     last_error_mode = ERROR_MODE_NONE;
 
 static error_info_t     error_info;
 
+static uint16_t         page_dir[DIR_SIZE];
+static uint32_t         leaf_pool[MAX_LEAVES][LEAF_WORDS];
+static int              num_leaves = 0;
+
+static uintptr_t        num_bad_pages   = 0;
+static int              num_saturated   = 0;
+
+static uint32_t         gb_counts[MAX_GB];
+static uint32_t         bit_counts[TESTWORD_WIDTH];
+
+static bool             heatmap_changed = false;
+
+static error_group_t    error_groups[MAX_ERROR_GROUPS];
+static int              num_error_groups = 0;
+static uintptr_t        num_unlisted_errors = 0;
+
+static const char       heat_chars[HEAT_LEVELS + 1] = " .:-=+*#%@";
+
+static int              summary_changed = 0;
+static int              summary_test_errors[NUM_TEST_PATTERNS];
+static int              summary_verdicts[NUM_RETEST_VERDICTS];
+
+static uint8_t          bit_count_table[256];
+
+static const uint8_t    lowest_bit_table[TESTWORD_WIDTH] = {
+#if TESTWORD_WIDTH > 32
+     0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+    62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+    63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+#else
+     0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+    31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+#endif
+};
+
 //------------------------------------------------------------------------------
 // Public Variables
 //------------------------------------------------------------------------------
@@ -66,52 +172,85 @@ uint64_t                error_count_cecc = 0;
 // Private Functions
 //------------------------------------------------------------------------------
 
-static bool update_error_info(testword_t page, testword_t offset, uintptr_t addr, testword_t xor)
+static void summary_test_position(int test, int *row, int *col)
 {
-    bool update_stats = false;
+    if (test < SUMMARY_ROWS) {
+        *row = 1 + test;
+        *col = 65;
+    } else {
+        *row = SUMMARY_ROW2 + test - SUMMARY_ROWS;
+        *col = 49;
+    }
+}
+
+static inline int count_bits(testword_t value)
+{
+#ifdef __POPCNT__
+    return __builtin_popcountll(value);
+#else
+    int bits = 0;
+    while (value != 0) {
+        bits += bit_count_table[value & 0xff];
+        value >>= 8;
+    }
+    return bits;
+#endif
+}
+
+// Returns the index of the least significant set bit, which must exist.
+static inline int lowest_bit(testword_t value)
+{
+    testword_t bit = value & -value;
+#if TESTWORD_WIDTH > 32
+    return lowest_bit_table[(uint64_t)(bit * 0x03f79d71b4cb0a89ULL) >> 58];
+#else
+    return lowest_bit_table[(uint32_t)(bit * 0x077cb531U) >> 27];
+#endif
+}
+
+// Returns a mask of the statistics that have changed.
+static int update_error_info(testword_t page, testword_t offset, uintptr_t addr, testword_t xor)
+{
+    int changed = 0;
 
     // Update address range.
 
     if (error_info.min_addr.page > page) {
         error_info.min_addr.page   = page;
         error_info.min_addr.offset = offset;
-        update_stats = true;
+        changed |= STAT_MIN_ADDR;
     } else if (error_info.min_addr.page == page && error_info.min_addr.offset > offset) {
         error_info.min_addr.offset = offset;
-        update_stats = true;
+        changed |= STAT_MIN_ADDR;
     }
     if (error_info.max_addr.page < page) {
         error_info.max_addr.page   = page;
         error_info.max_addr.offset = offset;
-        update_stats = true;
+        changed |= STAT_MAX_ADDR;
     } else if (error_info.max_addr.page == page && error_info.max_addr.offset < offset) {
         error_info.max_addr.offset = offset;
-        update_stats = true;
+        changed |= STAT_MAX_ADDR;
     }
 
     // Update bits in error.
 
-    int bits = 0;
-    for (int i = 0; i < TESTWORD_WIDTH; i++) {
-        if ((xor >> i) & 1) {
-            bits++;
-        }
-    }
+    int bits = count_bits(xor);
     if (bits > 0 && error_count < ERROR_LIMIT) {
         error_info.total_bits += bits;
+        changed |= STAT_NUM_BITS;
     }
     if (bits > error_info.max_bits) {
         error_info.max_bits = bits;
-        update_stats = true;
+        changed |= STAT_NUM_BITS;
     }
     if (bits < error_info.min_bits) {
         error_info.min_bits = bits;
-        update_stats = true;
+        changed |= STAT_NUM_BITS;
     }
-    if (error_info.bad_bits ^ xor) {
-        update_stats = true;
+    if (~error_info.bad_bits & xor) {
+        error_info.bad_bits |= xor;
+        changed |= STAT_BAD_BITS | STAT_NUM_BITS;
     }
-    error_info.bad_bits |= xor;
 
     // Update max contiguous range.
 
@@ -127,10 +266,281 @@ static bool update_error_info(testword_t page, testword_t offset, uintptr_t addr
     }
     if (error_info.run_length > error_info.max_run) {
         error_info.max_run = error_info.run_length;
-        update_stats = true;
+        changed |= STAT_MAX_RUN;
+    }
+
+    return changed;
+}
+
+static void record_error(uintptr_t page, testword_t xor)
+{
+    uintptr_t chunk = page >> LEAF_SHIFT;
+    if (chunk >= DIR_SIZE) {
+        chunk = DIR_SIZE - 1;
+        page  = (chunk << LEAF_SHIFT) + LEAF_PAGES - 1;
+    }
+
+    if (page_dir[chunk] == LEAF_NONE) {
+        if (num_leaves < MAX_LEAVES) {
+            page_dir[chunk] = ++num_leaves;
+        } else {
+            page_dir[chunk] = LEAF_SATURATED;
+            num_saturated++;
+        }
+    }
+    if (page_dir[chunk] != LEAF_SATURATED) {
+        uint32_t *leaf = leaf_pool[page_dir[chunk] - 1];
+        uintptr_t bit  = page & (LEAF_PAGES - 1);
+        if (!(leaf[bit / 32] >> (bit % 32) & 1)) {
+            leaf[bit / 32] |= (uint32_t)1 << (bit % 32);
+            num_bad_pages++;
+        }
+    }
+
+    uintptr_t gb = page >> GB_SHIFT;
+    if (gb_counts[gb] < UINT32_MAX) {
+        gb_counts[gb]++;
+    }
+    while (xor != 0) {
+        int i = lowest_bit(xor);
+        if (bit_counts[i] < UINT32_MAX) {
+            bit_counts[i]++;
+        }
+        xor &= xor - 1;
+    }
+
+    heatmap_changed = true;
+}
+
+static int log2_floor(uint32_t value)
+{
+    int log = 0;
+    while (value >>= 1) {
+        log++;
+    }
+    return log;
+}
+
+static int heat_level(uint32_t count, uint32_t max_count)
+{
+    if (count == 0) {
+        return 0;
+    }
+    // Use a logarithmic scale, so isolated errors remain visible.
+    int log_count = log2_floor(count);
+    int log_max   = log2_floor(max_count);
+    int level = 1 + (log_count * (HEAT_LEVELS - 2)) / (log_max > 0 ? log_max : 1);
+    return (level < HEAT_LEVELS - 1) ? level : HEAT_LEVELS - 1;
+}
+
+static void display_heatmap(void)
+{
+    uint32_t max_count = 0;
+    int num_lanes = 0;
+    for (int i = 0; i < TESTWORD_WIDTH; i++) {
+        if (bit_counts[i] > max_count) {
+            max_count = bit_counts[i];
+        }
+        if (bit_counts[i] > 0) {
+            num_lanes++;
+        }
+    }
+    display_pinned_message(0, 22, "%u", num_bad_pages);
+    if (num_saturated > 0) {
+        display_pinned_message(0, 32, "(+%i x 128MB unresolved)", num_saturated);
+    }
+    display_pinned_message(0, 70, "%i ", num_lanes);
+
+    // Bit lanes, most significant first.
+    for (int i = 0; i < TESTWORD_WIDTH; i++) {
+        int col = 10 + TESTWORD_WIDTH - 1 - i;
+        printc(ROW_MESSAGE_T + 4, col, heat_chars[heat_level(bit_counts[i], max_count)]);
+    }
+
+    // Address space, in GB, scaled to fit the available cells.
+    uintptr_t num_gb = ((pm_map[pm_map_size - 1].end - 1) >> GB_SHIFT) + 1;
+    if (num_gb > MAX_GB) {
+        num_gb = MAX_GB;
+    }
+    uintptr_t gb_per_cell = (num_gb + HEAT_COLS * HEAT_ROWS - 1) / (HEAT_COLS * HEAT_ROWS);
+    max_count = 0;
+    for (uintptr_t gb = 0; gb < num_gb; gb++) {
+        if (gb_counts[gb] > max_count) {
+            max_count = gb_counts[gb];
+        }
+    }
+    max_count = (max_count > UINT32_MAX / gb_per_cell) ? UINT32_MAX : max_count * gb_per_cell;
+    for (uintptr_t cell = 0; cell * gb_per_cell < num_gb; cell++) {
+        uint32_t count = 0;
+        for (uintptr_t gb = cell * gb_per_cell; gb < (cell + 1) * gb_per_cell && gb < num_gb; gb++) {
+            count = (count + gb_counts[gb] < count) ? UINT32_MAX : count + gb_counts[gb];
+        }
+        int row = cell / HEAT_COLS;
+        int col = cell % HEAT_COLS;
+        if (col == 0) {
+            display_pinned_message(7 + row, 0, "%5uG", cell * gb_per_cell);
+        }
+        printc(ROW_MESSAGE_T + 7 + row, 10 + col, heat_chars[heat_level(count, max_count)]);
+    }
+    display_pinned_message(6, 10, "%uGB per cell", gb_per_cell);
+}
+
+// Must be called with the error mutex held.
+static void add_to_error_group(error_type_t type, uintptr_t addr, testword_t page, testword_t offset,
+                               testword_t good, testword_t bad, testword_t xor)
+{
+    bool parity = (type == PARITY_ERROR);
+
+    // Extend the current group if this error has the same error bits and
+    // continues the same address stride.
+    if (num_error_groups > 0) {
+        error_group_t *group = &error_groups[num_error_groups - 1];
+        intptr_t stride = addr - group->last_addr;
+        if (!parity && !group->parity && xor == group->xor && group->test == test_num
+        &&  stride != 0 && (group->count == 1 || stride == group->stride)) {
+            group->stride      = stride;
+            group->last.page   = page;
+            group->last.offset = offset;
+            group->last_addr   = addr;
+            group->count++;
+            return;
+        }
     }
 
-    return update_stats;
+    if (num_error_groups == MAX_ERROR_GROUPS) {
+        num_unlisted_errors++;
+        return;
+    }
+
+    error_group_t *group = &error_groups[num_error_groups++];
+    group->parity       = parity;
+    group->cpu          = cpu_current();
+    group->pass         = pass_num;
+    group->test         = test_num;
+    group->number       = error_count;
+    group->first.page   = page;
+    group->first.offset = offset;
+    group->last         = group->first;
+    group->last_addr    = addr;
+    group->stride       = 0;
+    group->count        = 1;
+    group->good         = good;
+    group->bad          = bad;
+    group->xor          = xor;
+}
+
+static void display_error_groups(void)
+{
+    error_group_t groups[MAX_ERROR_GROUPS];
+
+    // Take a copy, so other CPUs aren't held up if the display is paused.
+    spin_lock(error_mutex);
+    int num_groups = num_error_groups;
+    for (int i = 0; i < num_groups; i++) {
+        groups[i] = error_groups[i];
+    }
+    uintptr_t num_unlisted = num_unlisted_errors;
+    num_error_groups    = 0;
+    num_unlisted_errors = 0;
+    spin_unlock(error_mutex);
+
+    for (int i = 0; i < num_groups; i++) {
+        error_group_t *group = &groups[i];
+
+        scroll();
+
+        set_foreground_colour(YELLOW);
+
+        if (group->count > 1) {
+            display_scrolled_message(0, " %2i   %4i   %2i   %u errors %09x%03x-%09x%03x, bits %x",
+                                     group->cpu, group->pass, group->test, group->count,
+                                     group->first.page, group->first.offset,
+                                     group->last.page, group->last.offset,
+                                     group->xor);
+            set_foreground_colour(WHITE);
+            continue;
+        }
+
+        display_scrolled_message(0, " %2i   %4i   %2i   %09x%03x (%kB)",
+                                 group->cpu, group->pass, group->test,
+                                 group->first.page, group->first.offset, group->first.page << 2);
+
+        if (group->parity) {
+            display_scrolled_message(41, "%s", "Parity error detected near this address");
+        } else {
+#if TESTWORD_WIDTH > 32
+            display_scrolled_message(41, "%016x  %016x", group->good, group->bad);
+#else
+            display_scrolled_message(41, "%08x  %08x  %08x  %i", group->good, group->bad, group->xor, group->number);
+#endif
+        }
+
+        set_foreground_colour(WHITE);
+    }
+    if (num_unlisted > 0) {
+        scroll();
+        display_scrolled_message(18, "%u more errors not listed", num_unlisted);
+    }
+}
+
+static void display_summary(void)
+{
+    if (summary_changed & STAT_MIN_ADDR) {
+        display_pinned_message(0, 25, "%09x%03x (%kB)",
+                                      error_info.min_addr.page,
+                                      error_info.min_addr.offset,
+                                      error_info.min_addr.page << 2);
+    }
+    if (summary_changed & STAT_MAX_ADDR) {
+        display_pinned_message(1, 25, "%09x%03x (%kB)",
+                                      error_info.max_addr.page,
+                                      error_info.max_addr.offset,
+                                      error_info.max_addr.page << 2);
+    }
+    if (summary_changed & STAT_BAD_BITS) {
+        display_pinned_message(2, 25, "%0*x", TESTWORD_DIGITS,
+                                      error_info.bad_bits);
+    }
+    if ((summary_changed & STAT_NUM_BITS) && error_count > 0) {
+        display_pinned_message(3, 25, " %2i Min: %2i Max: %2i Avg: %2i",
+                                      count_bits(error_info.bad_bits),
+                                      error_info.min_bits,
+                                      error_info.max_bits,
+                                      (int)(error_info.total_bits / error_count));
+    }
+    if (summary_changed & STAT_MAX_RUN) {
+        display_pinned_message(4, 25, "%u",
+                                      error_info.max_run);
+    }
+    summary_changed = 0;
+
+    bool new_verdicts = false;
+    for (int i = 0; i < NUM_RETEST_VERDICTS; i++) {
+        if (retest_num_verdicts(i) != summary_verdicts[i]) {
+            summary_verdicts[i] = retest_num_verdicts(i);
+            new_verdicts = true;
+        }
+    }
+    if (new_verdicts && summary_verdicts[RETEST_UNSUPPORTED] > 0) {
+        display_pinned_message(5, 25, "Unsupported: %i", summary_verdicts[RETEST_UNSUPPORTED]);
+    } else if (new_verdicts) {
+        display_pinned_message(5, 25, "Rep: %i Int: %i None: %i Pending: %i",
+                                      summary_verdicts[RETEST_REPRODUCIBLE],
+                                      summary_verdicts[RETEST_INTERMITTENT],
+                                      summary_verdicts[RETEST_NOT_REPRODUCED],
+                                      summary_verdicts[RETEST_PENDING]);
+    }
+
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        if (test_list[i].errors != summary_test_errors[i]) {
+            summary_test_errors[i] = test_list[i].errors;
+            int row, col;
+            summary_test_position(i, &row, &col);
+            display_pinned_message(row, col + 4, "%c%i",
+                                   test_list[i].errors == INT_MAX ? '>' : ' ',
+                                   test_list[i].errors);
+        }
+    }
 }
 
 static void common_err(error_type_t type, uintptr_t addr, testword_t good, testword_t bad, bool use_for_badram)
@@ -148,25 +558,36 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
 
     testword_t xor = good ^ bad;
 
-    bool new_stats = false;
     testword_t page   = page_of((void *)addr);
     testword_t offset = addr & (PAGE_SIZE - 1);
 
     switch (type) {
       case ADDR_ERROR:
-        new_stats = update_error_info(page, offset, addr, 0);
+        summary_changed |= update_error_info(page, offset, addr, 0);
+        record_error(page, 0);
         break;
       case DATA_ERROR:
-        new_stats = update_error_info(page, offset, addr, xor);
+        summary_changed |= update_error_info(page, offset, addr, xor);
+        record_error(page, xor);
         break;
-      case NEW_MODE:
-        new_stats = (error_count > 0);
       default:
         break;
     }
+#ifdef FAULT_SIM
+    if (type == ADDR_ERROR || type == DATA_ERROR) {
+        faultsim_error(addr);
+    }
+#endif
 
     bool new_address = (type != NEW_MODE);
 
+    if (type == DATA_ERROR && use_for_badram) {
+        badmem_insert(page);
+        if (enable_retest) {
+            retest_enqueue(page, offset, good, bad);
+        }
+    }
+
     bool new_badram = false;
     if (error_mode == ERROR_MODE_BADRAM && use_for_badram) {
         new_badram = badram_insert(page, offset);
@@ -194,46 +615,27 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
             display_pinned_message(2, 1,  "    Bits in Error Mask:");
             display_pinned_message(3, 1,  " Bits in Error - Total:");
             display_pinned_message(4, 1,  " Max Contiguous Errors:");
-
-            display_pinned_message(0, 64, "Test  Errors");
-            for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
-                display_pinned_message(1 + i, 65, "%2i:", i);
-            }
-
-        }
-        if (new_stats) {
-            int bits = 0;
-            for (int i = 0; i < TESTWORD_WIDTH; i++) {
-                if (error_info.bad_bits >> i & 1) {
-                    bits++;
+            if (enable_retest) {
+                display_pinned_message(5, 1,  "        Retest Results:");
+                for (int i = 0; i < NUM_RETEST_VERDICTS; i++) {
+                    summary_verdicts[i] = -1;
                 }
             }
-            display_pinned_message(0, 25, "%09x%03x (%kB)",
-                                          error_info.min_addr.page,
-                                          error_info.min_addr.offset,
-                                          error_info.min_addr.page << 2);
-            display_pinned_message(1, 25, "%09x%03x (%kB)",
-                                          error_info.max_addr.page,
-                                          error_info.max_addr.offset,
-                                          error_info.max_addr.page << 2);
-            display_pinned_message(2, 25, "%0*x", TESTWORD_DIGITS,
-                                          error_info.bad_bits);
-            display_pinned_message(3, 25, " %2i Min: %2i Max: %2i Avg: %2i",
-                                          bits,
-                                          error_info.min_bits,
-                                          error_info.max_bits,
-                                          (int)(error_info.total_bits / error_count));
-            display_pinned_message(4, 25, "%u",
-                                          error_info.max_run);
 
+            display_pinned_message(0, 64, "Test  Errors");
+            if (NUM_TEST_PATTERNS > SUMMARY_ROWS) {
+                display_pinned_message(SUMMARY_ROW2 - 1, 48, "Test  Errors");
+            }
             for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
-                display_pinned_message(1 + i, 69, "%c%i",
-                                       test_list[i].errors == INT_MAX ? '>' : ' ',
-                                       test_list[i].errors);
+                int row, col;
+                summary_test_position(i, &row, &col);
+                display_pinned_message(row, col, "%2i:", i);
+                summary_test_errors[i] = -1;
             }
-
-            display_error_count();
+            summary_changed = STAT_ALL;
         }
+        // The statistics are displayed by error_update, so that they are
+        // redrawn at most once per tick.
         break;
 
       case ERROR_MODE_ADDRESS:
@@ -253,29 +655,13 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
             display_pinned_message(1, 0, "----  ----  ----  ---------------------  --------  --------  --------");
             //                  fields:    NN   NNNN   NN   PPPPPPPPPOOO (N.NN?B)  XXXXXXXX  XXXXXXXX  XXXXXXXX
 #endif
+            num_error_groups    = 0;
+            num_unlisted_errors = 0;
         }
         if (new_address) {
-            check_input();
-            scroll();
-
-            set_foreground_colour(YELLOW);
-
-            display_scrolled_message(0, " %2i   %4i   %2i   %09x%03x (%kB)",
-                                     cpu_current(), pass_num, test_num, page, offset, page << 2);
-
-            if (type == PARITY_ERROR) {
-                display_scrolled_message(41, "%s", "Parity error detected near this address");
-            } else {
-#if TESTWORD_WIDTH > 32
-                display_scrolled_message(41, "%016x  %016x", good, bad);
-#else
-                display_scrolled_message(41, "%08x  %08x  %08x  %i", good, bad, xor, error_count);
-#endif
-            }
-
-            set_foreground_colour(WHITE);
-
-            display_error_count();
+            // The errors are displayed by error_update, so that an error storm
+            // doesn't slow the test down to the speed of the display.
+            add_to_error_group(type, addr, page, offset, good, bad, xor);
         }
         break;
 
@@ -285,6 +671,21 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
         }
         break;
 
+      case ERROR_MODE_HEATMAP:
+        // The heatmap is redrawn by error_update, to keep the cost per error low.
+        if (new_header) {
+            display_pinned_message(0, 0, "Failing pages:");
+            display_pinned_message(0, 50, "Bit lanes in error:");
+            display_pinned_message(1, 0, "Heat: \"%s\" (log scale, low to high)", heat_chars);
+            display_pinned_message(3, 0, "Bit");
+            for (int i = 0; i < TESTWORD_WIDTH; i += 8) {
+                display_pinned_message(3, 10 + TESTWORD_WIDTH - 1 - i - 7, "%-4i%4i", i + 7, i);
+            }
+            display_pinned_message(6, 0, "Address");
+            heatmap_changed = true;
+        }
+        break;
+
       default:
         break;
     }
@@ -317,6 +718,61 @@ void error_init(void)
     error_info.last_xor         = 0;
 
     error_count = 0;
+
+    summary_changed = 0;
+
+    for (int i = 1; i < 256; i++) {
+        bit_count_table[i] = (i & 1) + bit_count_table[i / 2];
+    }
+
+    for (int i = 0; i < DIR_SIZE; i++) {
+        page_dir[i] = LEAF_NONE;
+    }
+    for (int i = 0; i < num_leaves; i++) {
+        memset(leaf_pool[i], 0, sizeof(leaf_pool[i]));
+    }
+    num_leaves    = 0;
+    num_bad_pages = 0;
+    num_saturated = 0;
+    memset(gb_counts,  0, sizeof(gb_counts));
+    memset(bit_counts, 0, sizeof(bit_counts));
+    heatmap_changed = false;
+}
+
+void error_get_summary(error_summary_t *summary)
+{
+    summary->min_addr   = (uint64_t)error_info.min_addr.page << PAGE_SHIFT | error_info.min_addr.offset;
+    summary->max_addr   = (uint64_t)error_info.max_addr.page << PAGE_SHIFT | error_info.max_addr.offset;
+    summary->bad_bits   = error_info.bad_bits;
+    summary->total_bits = error_info.total_bits;
+    summary->max_run    = error_info.max_run;
+    summary->min_bits   = error_info.min_bits;
+    summary->max_bits   = error_info.max_bits;
+}
+
+void error_restore(uint64_t count, const error_summary_t *summary)
+{
+    if (count == 0) {
+        return;
+    }
+    spin_lock(error_mutex);
+
+    error_info.min_addr.page    = summary->min_addr >> PAGE_SHIFT;
+    error_info.min_addr.offset  = summary->min_addr & (PAGE_SIZE - 1);
+    error_info.max_addr.page    = summary->max_addr >> PAGE_SHIFT;
+    error_info.max_addr.offset  = summary->max_addr & (PAGE_SIZE - 1);
+    error_info.bad_bits         = summary->bad_bits;
+    error_info.total_bits       = summary->total_bits;
+    error_info.max_run          = summary->max_run;
+    error_info.min_bits         = summary->min_bits;
+    error_info.max_bits         = summary->max_bits;
+
+    error_count = count;
+
+    // Force the error display to be redrawn by the next call to error_update.
+    last_error_mode = ERROR_MODE_NONE;
+
+    spin_unlock(error_mutex);
 }
 
 void addr_error(testword_t *addr1, testword_t *addr2, testword_t good, testword_t bad)
@@ -329,6 +785,40 @@ void data_error(testword_t *addr, testword_t good, testword_t bad, bool use_for_
     common_err(DATA_ERROR, (uintptr_t)addr, good, bad, use_for_badram);
 }
 
+bool error_pages_in_range(uintptr_t start, uintptr_t end)
+{
+    uintptr_t page = start;
+    while (page < end) {
+        uintptr_t chunk = page >> LEAF_SHIFT;
+        if (chunk >= DIR_SIZE) {
+            break;
+        }
+        uintptr_t chunk_end = (chunk + 1) << LEAF_SHIFT;
+        uintptr_t limit = (end < chunk_end) ? end : chunk_end;
+        if (page_dir[chunk] == LEAF_SATURATED) {
+            return true;
+        }
+        if (page_dir[chunk] != LEAF_NONE) {
+            const uint32_t *leaf = leaf_pool[page_dir[chunk] - 1];
+            while (page < limit) {
+                uintptr_t bit  = page & (LEAF_PAGES - 1);
+                uint32_t  word = leaf[bit / 32] >> (bit % 32);
+                uintptr_t span = 32 - (bit % 32);
+                if (span > limit - page) {
+                    span = limit - page;
+                    word &= ((uint32_t)1 << span) - 1;
+                }
+                if (word != 0) {
+                    return true;
+                }
+                page += span;
+            }
+        }
+        page = limit;
+    }
+    return false;
+}
+
 #if REPORT_PARITY_ERRORS
 void parity_error(void)
 {
@@ -344,10 +834,15 @@ void error_update(void)
         if (error_mode != last_error_mode) {
             common_err(NEW_MODE, 0, 0, 0, false);
         }
-        if (error_mode == ERROR_MODE_SUMMARY && test_list[test_num].errors > 0) {
-            display_pinned_message(1 + test_num, 69, "%c%i",
-                                   test_list[test_num].errors == INT_MAX ? '>' : ' ',
-                                   test_list[test_num].errors);
+        if (error_mode == ERROR_MODE_SUMMARY) {
+            display_summary();
+        }
+        if (error_mode == ERROR_MODE_ADDRESS && (num_error_groups > 0 || num_unlisted_errors > 0)) {
+            display_error_groups();
+        }
+        if (error_mode == ERROR_MODE_HEATMAP && heatmap_changed) {
+            display_heatmap();
+            heatmap_changed = false;
         }
         display_error_count();
 
@@ -15,6 +15,19 @@
 
 #include "test.h"
 
+/**
+ * The error summary statistics, in a form that can be saved and restored.
+ */
+typedef struct {
+    uint64_t    min_addr;
+    uint64_t    max_addr;
+    uint64_t    bad_bits;
+    uint64_t    total_bits;
+    uintptr_t   max_run;
+    int         min_bits;
+    int         max_bits;
+} error_summary_t;
+
 /**
  * The number of errors recorded during the current run.
  */
@@ -30,6 +43,19 @@ extern uint64_t error_count_cecc;
  */
 void error_init(void);
 
+/**
+ * Copies the current error summary statistics to summary.
+ */
+void error_get_summary(error_summary_t *summary);
+
+/**
+ * Restores the error count and summary statistics saved from an earlier run.
+ * The error display is redrawn at the next update. Error details that are not
+ * part of the summary (the address list, BadRAM patterns, and heatmap) only
+ * include errors found after the restore.
+ */
+void error_restore(uint64_t count, const error_summary_t *summary);
+
 /**
  * Adds an address error to the error reports.
  */
@@ -53,6 +79,12 @@ void ecc_error();
 void parity_error(void);
 #endif
 
+/**
+ * Returns true if any page in the range [start, end) has been recorded as
+ * failing in this run.
+ */
+bool error_pages_in_range(uintptr_t start, uintptr_t end);
+
 /**
  * Refreshes the error display after the error mode is changed.
  */
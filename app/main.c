@@ -17,12 +17,22 @@
 
 #include "cache.h"
 #include "cpuinfo.h"
+#ifdef FAULT_SIM
+#include "faultsim.h"
+#endif
 #include "serial.h"
 #include "vmem.h"
+#include "badmem.h"
 #include "badram.h"
+#include "bgfade.h"
+#include "checkpoint.h"
 #include "display.h"
 #include "error.h"
+#include "planner.h"
+#include "retest.h"
+#include "sample.h"
 #include "tests.h"
+#include "trace.h"
 
 //------------------------------------------------------------------------------
 // Constants
@@ -34,6 +44,14 @@
 
 #define LOW_LOAD_LIMIT      SIZE_C(4,MB)  // must be a multiple of the page size
 
+#define CMD_LINE_SIZE       512           // must hold a resume= checkpoint record
+
+// In adaptive mode, the iterations used in windows that contain failing
+// pages are multiplied, and in the other windows divided, by these factors.
+// This doesn't apply to the tests where the iteration count is a time.
+#define ADAPT_HOT_FACTOR    2
+#define ADAPT_COLD_DIVISOR  2
+
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
@@ -61,6 +79,25 @@ static size_t           num_mapped_pages = 0;
 
 static int              test_stage = 0;
 
+static bool             test_planned = false;
+static int              test_iterations = 0;
+static int              window_iterations = 0;
+
+// The iterations used in each window, weighted by the pages in the window,
+// summed over the current test.
+static uint64_t         iteration_pages = 0;
+static uint64_t         tested_pages    = 0;
+
+static int              test_order[NUM_TEST_PATTERNS];
+static int              test_index = 0;
+
+static bool             resuming = false;
+static run_position_t   resume_point;
+
+static const char       *boot_args = NULL;
+
+static char             cmd_line[CMD_LINE_SIZE];
+
 //------------------------------------------------------------------------------
 // Public Variables
 //------------------------------------------------------------------------------
@@ -86,13 +123,14 @@ int         pass_num = 0;
 int         test_num = 0;
 
 int         window_num = 0;
+int         windows_tested = 0;
 
 bool        restart = false;
 bool        bail    = false;
 
 uintptr_t   test_addr[MAX_CPUS];
 
-uint8_t _stacks[AP_STACK_SIZE];
+uint8_t _stacks[MAX_CPUS * AP_STACK_SIZE];
 
 //------------------------------------------------------------------------------
 // Private Functions
@@ -124,12 +162,29 @@ static void global_init(void)
 
     pmem_init();
 
+    checkpoint_init();
+
+#ifdef FAULT_SIM
+    faultsim_init();
+#endif
+
     membw_init();
 
     badram_init();
 
+    badmem_init();
+
+    retest_init();
+
     config_init();
 
+    if (boot_args != NULL) {
+        strncpy(cmd_line, boot_args, CMD_LINE_SIZE - 1);
+        parse_command_line(cmd_line, CMD_LINE_SIZE);
+    }
+
+    checkpoint_reserve();
+
     tty_init();
 
     // At this point we have started reserving physical pages in the memory
@@ -146,23 +201,33 @@ static void global_init(void)
 
     clear_message_area();
 
+#if defined(__ARCH_NATIVE)
+    // Each CPU is run by a separate process, started by mpe_init().
+    num_enabled_cpus = smp_enabled ? cpu_count() : 1;
+    if (num_enabled_cpus > MAX_CPUS) {
+        num_enabled_cpus = MAX_CPUS;
+    }
+#else
     num_enabled_cpus = 1;
-    chunk_index[0] = num_enabled_cpus;
+#endif
+    for (int i = 0; i < num_enabled_cpus; i++) {
+        chunk_index[i] = i;
+    }
     display_cpu_topology();
 
     master_cpu = 0;
 
-    if (enable_trace) {
-        display_pinned_message(0, 0,"CPU Trace");
-        display_pinned_message(1, 0,"--- ----------------------------------------------------------------------------");
-//        set_scroll_lock(true);
-    } else if (enable_sm) {
+    if (enable_sm) {
         post_display_init();
     }
 
     for (int i = 0; i < pm_map_size; i++) {
         trace(0, "pm %0*x - %0*x", 2*sizeof(uintptr_t), pm_map[i].start, 2*sizeof(uintptr_t), pm_map[i].end);
     }
+#if defined(__ARCH_NATIVE)
+    trace(0, "os memory at %x, %kB in huge pages, locked %s", (uintptr_t)first_word_mapping(pm_map[0].start),
+          (uintptr_t)(os_mem_huge_size >> 10), os_mem_locked ? "yes" : "no");
+#endif
 
     barrier_init(start_barrier, 1);
     barrier_init(run_barrier,   1);
@@ -174,6 +239,26 @@ static void global_init(void)
     restart = false;
 }
 
+static void add_vm_segment(uintptr_t seg_start, uintptr_t seg_end)
+{
+    // Skip the region reserved for the background bit fade test.
+    uintptr_t fade_start, fade_end;
+    if (bgfade_region(&fade_start, &fade_end) && seg_start < fade_end && seg_end > fade_start) {
+        if (seg_start < fade_start && vm_map_size < MAX_MEM_SEGMENTS) {
+            add_vm_segment(seg_start, fade_start);
+        }
+        if (seg_end > fade_end && vm_map_size < MAX_MEM_SEGMENTS) {
+            add_vm_segment(fade_end, seg_end);
+        }
+        return;
+    }
+    num_mapped_pages += seg_end - seg_start;
+    vm_map[vm_map_size].pm_base_addr = seg_start;
+    vm_map[vm_map_size].start        = first_word_mapping(seg_start);
+    vm_map[vm_map_size].end          = last_word_mapping(seg_end - 1, sizeof(testword_t));
+    vm_map_size++;
+}
+
 static void setup_vm_map(uintptr_t win_start, uintptr_t win_end)
 {
     vm_map_size = 0;
@@ -204,15 +289,57 @@ static void setup_vm_map(uintptr_t win_start, uintptr_t win_end)
             seg_end = win_end;
         }
         if (seg_start < seg_end && seg_start < win_end && seg_end > win_start) {
-            num_mapped_pages += seg_end - seg_start;
-            vm_map[vm_map_size].pm_base_addr = seg_start;
-            vm_map[vm_map_size].start        = first_word_mapping(seg_start);
-            vm_map[vm_map_size].end          = last_word_mapping(seg_end - 1, sizeof(testword_t));
-            vm_map_size++;
+            if (sample_percent > 0) {
+                // Only map the pages selected for this pass.
+                uintptr_t page = seg_start;
+                uintptr_t run_start, run_end;
+                while (vm_map_size < MAX_MEM_SEGMENTS && sample_next_run(&page, seg_end, &run_start, &run_end)) {
+                    add_vm_segment(run_start, run_end);
+                }
+            } else {
+                add_vm_segment(seg_start, seg_end);
+            }
         }
     }
 }
 
+static int adaptive_iterations(uintptr_t win_start, uintptr_t win_end)
+{
+    int iterations = test_iterations;
+    if (!enable_adaptive || dummy_run || error_count == 0) {
+        return iterations;
+    }
+    if (test_num == BIT_FADE_TEST || test_num == COPY_TEST) {
+        // The iteration count is a time, which must be the same for all windows.
+        return iterations;
+    }
+    if (error_pages_in_range(win_start, win_end)) {
+        return iterations * ADAPT_HOT_FACTOR;
+    }
+    iterations /= ADAPT_COLD_DIVISOR;
+    return iterations > 0 ? iterations : 1;
+}
+
+static void save_checkpoint(bool to_console)
+{
+    run_position_t position = { pass_num, test_num, test_stage, window_num, { 0 } };
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        position.test_order[i] = test_order[i];
+    }
+    checkpoint_save(&position, to_console);
+}
+
+// Returns the average number of iterations used per page in the current test,
+// which differs from test_iterations in adaptive mode.
+static int tested_iterations(void)
+{
+    if (tested_pages == 0) {
+        return test_iterations;
+    }
+    int iterations = (iteration_pages + tested_pages / 2) / tested_pages;
+    return iterations > 0 ? iterations : 1;
+}
+
 static void test_all_windows(int my_cpu)
 {
     bool parallel_test = false;
@@ -239,12 +366,7 @@ static void test_all_windows(int my_cpu)
             }
         }
         barrier_reset(run_barrier, num_active_cpus);
-    }
-
-    int iterations = test_list[test_num].iterations;
-    if (pass_num == 0) {
-        // Reduce iterations for a faster first pass.
-        iterations /= 3;
+        windows_tested = 0;
     }
 
     // Loop through all possible windows.
@@ -283,9 +405,12 @@ static void test_all_windows(int my_cpu)
                 window_end  += VM_WINDOW_SIZE;
             }
             setup_vm_map(window_start, window_end);
+            window_iterations = adaptive_iterations(window_start, window_end);
         }
         SHORT_BARRIER;
 
+        int iterations = window_iterations;
+
         if (!i_am_active) {
             continue;
         }
@@ -312,6 +437,12 @@ static void test_all_windows(int my_cpu)
 
         if (i_am_master) {
             window_num++;
+            windows_tested++;
+            iteration_pages += (uint64_t)iterations * num_mapped_pages;
+            tested_pages    += num_mapped_pages;
+            if (!dummy_run) {
+                save_checkpoint(false);
+            }
         }
     } while (window_end < pm_map[pm_map_size - 1].end);
 }
@@ -325,29 +456,24 @@ static void select_next_master(void)
 // Public Functions
 //------------------------------------------------------------------------------
 
-// The main entry point called from the startup code.
-
 static Context *simple_trap(Event ev, Context *ctx) {
   switch (ev.event) {
     case EVENT_ERROR:
 //      printf("ERROR@pc = %p: %s\n", ctx->eip, ev.msg);
       assert(0);
+    case EVENT_IRQ_TIMER:
+      timer_interrupt();
+      break;
     default:;
   }
   return ctx;
 }
 
-void main(void)
+// The code run by each CPU.
+
+static void run(void)
 {
-  ioe_init();
-  cte_init(simple_trap);
-    int my_cpu;
-    if (init_state == 0) {
-        // If this is the first time here, we must be CPU 0, as the APs haven't been started yet.
-        my_cpu = 0;
-    } else {
-        my_cpu = cpu_current();
-    }
+    int my_cpu = cpu_current();
     if (init_state < 2) {
         cache_on();
         if (my_cpu == 0) {
@@ -366,6 +492,12 @@ void main(void)
             }
         }
     }
+    if (my_cpu >= num_enabled_cpus) {
+        // This CPU is not being used.
+        while (true) {
+            usleep(1000000);
+        }
+    }
 
     // Due to the need to relocate ourselves in the middle of tests, the following
     // code cannot be written in the natural way as a set of nested loops. So we
@@ -378,15 +510,59 @@ void main(void)
             if (start_run) {
                 pass_num = 0;
                 start_pass = true;
+                if (sample_percent > 0) {
+                    sample_init();
+                }
                 if (!dummy_run) {
                     display_start_run();
+                    planner_init();
                     badram_init();
+                    badmem_init();
+                    retest_init();
                     error_init();
+#ifdef FAULT_SIM
+                    faultsim_reset();
+#endif
+                    resuming = checkpoint_restore(&resume_point);
+                    if (resuming) {
+                        pass_num = resume_point.pass_num;
+                        display_pass_count(pass_num);
+                        display_error_count();
+                    }
                 }
             }
             if (start_pass) {
-                test_num = 0;
+                if (dummy_run) {
+                    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+                        test_order[i] = i;
+                    }
+                } else if (resuming) {
+                    // Continue the interrupted pass in the same order.
+                    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+                        test_order[i] = resume_point.test_order[i];
+                    }
+                    planner_use_order(test_order);
+                } else {
+                    planner_order_tests(test_order);
+                }
+                test_index = 0;
+                if (resuming) {
+                    while (test_index < NUM_TEST_PATTERNS - 1 && test_order[test_index] != resume_point.test_num) {
+                        test_index++;
+                    }
+                }
+                test_num = test_order[test_index];
                 start_test = true;
+                if (sample_percent > 0) {
+                    sample_select();
+                }
+                if (enable_bgfade && !dummy_run && test_list[BIT_FADE_TEST].enabled) {
+                    int fade_secs = test_list[BIT_FADE_TEST].iterations;
+                    if (pass_num == 0) {
+                        fade_secs /= 3;
+                    }
+                    bgfade_start_pass(pass_num, fade_secs);
+                }
                 if (dummy_run) {
                     ticks_per_pass[pass_num] = 0;
                 } else {
@@ -395,12 +571,27 @@ void main(void)
             }
             if (start_test) {
                 trace(my_cpu, "start test %i", test_num);
-                test_stage = 0;
+                test_stage = resuming ? resume_point.test_stage : 0;
                 rerun_test = true;
+                test_planned = test_list[test_num].enabled;
+                if (enable_bgfade && test_num == BIT_FADE_TEST) {
+                    // This is run in the background instead.
+                    test_planned = false;
+                }
+                test_iterations = planner_default_iterations(test_num);
+                iteration_pages = 0;
+                tested_pages    = 0;
                 if (dummy_run) {
                     ticks_per_test[pass_num][test_num] = 0;
-                } else if (test_list[test_num].enabled) {
-                    display_start_test();
+                } else if (test_planned) {
+                    test_iterations = planner_iterations(test_num, test_iterations);
+                    test_planned = (test_iterations > 0);
+                    if (test_planned) {
+                        display_start_test();
+#ifdef FAULT_SIM
+                        faultsim_test_start(test_num);
+#endif
+                    }
                 }
                 bail = false;
             }
@@ -408,6 +599,17 @@ void main(void)
                 window_num   = 0;
                 window_start = 0;
                 window_end   = 0;
+                if (resuming) {
+                    // Skip the windows that were completed before the restart.
+                    window_num = resume_point.window_num;
+                    if (window_num >= 2) {
+                        window_end = (window_num - 1) * VM_WINDOW_SIZE;
+                    }
+                    resuming = false;
+                }
+                if (!dummy_run) {
+                    save_checkpoint(enable_checkpoint && test_stage == 0 && window_num == 0);
+                }
             }
             start_run  = false;
             start_pass = false;
@@ -415,7 +617,7 @@ void main(void)
             rerun_test = false;
         }
         SHORT_BARRIER;
-        if (test_list[test_num].enabled) {
+        if (test_planned) {
             test_all_windows(my_cpu);
         }
         SHORT_BARRIER;
@@ -434,7 +636,25 @@ void main(void)
         }
         error_update();
 
-        if (test_list[test_num].enabled) {
+        if (!dummy_run && planner_expired()) {
+            // The time budget has been used up, so report the final status and stop.
+            if (enable_retest) {
+                retest_run();
+            }
+            if (export_formats != 0) {
+                badmem_export(export_formats);
+            }
+            if (enable_trace && error_count == 0) {
+                // Don't overwrite the error report.
+                trace_dump();
+            }
+            display_status(error_count == 0 ? "Done   " : "Failed!");
+            display_big_status(error_count == 0);
+            checkpoint_clear();
+            halt(error_count == 0 ? 0 : 1);
+        }
+
+        if (test_planned) {
             if (++test_stage < test_list[test_num].stages) {
                 rerun_test = true;
                 continue;
@@ -468,11 +688,23 @@ void main(void)
 
         if (dummy_run) {
             ticks_per_pass[pass_num] += ticks_per_test[pass_num][test_num];
+        } else if (test_planned) {
+            planner_test_done(test_num, tested_iterations());
+            if (sample_percent > 0 && !bail) {
+                sample_test_done(test_num);
+            }
+            if (enable_retest) {
+                retest_run();
+            }
+        }
+        if (!dummy_run) {
+            bgfade_poll(false);
         }
 
         start_test = true;
-        test_num++;
-        if (test_num < NUM_TEST_PATTERNS) {
+        test_index++;
+        if (test_index < NUM_TEST_PATTERNS) {
+            test_num = test_order[test_index];
             continue;
         }
 
@@ -485,7 +717,17 @@ void main(void)
 
         start_pass = true;
         if (!dummy_run) {
+            bgfade_poll(true);
             display_pass_count(pass_num);
+            if (export_formats != 0) {
+                badmem_export(export_formats);
+            }
+            if (sample_percent > 0) {
+                sample_report();
+            }
+#ifdef FAULT_SIM
+            faultsim_report(NUM_TEST_PATTERNS);
+#endif
             if (error_count == 0) {
                 display_status("Pass   ");
                 display_big_status(true);
@@ -495,3 +737,23 @@ void main(void)
         }
     }
 }
+
+// The main entry point called from the startup code.
+
+void main(const char *args)
+{
+  boot_args = args;
+  ioe_init();
+  cte_init(simple_trap);
+#if defined(__ARCH_NATIVE)
+  // The memory to be tested must be allocated before the other CPUs are
+  // started, so that they all share it.
+  if (boot_args != NULL) {
+      parse_early_options(boot_args);
+  }
+  pmem_os_alloc();
+  mpe_init(run);
+#else
+  run();
+#endif
+}
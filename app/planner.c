@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0
+// Fits the tests into a wall-clock time budget. The time taken by each test
+// is measured as it runs, and before the first measurement is available it
+// is estimated from the tick counts obtained by the dummy run. At the start
+// of each test the cost of the rest of the pass is estimated:
+//
+//  - if it fits in the remaining time, the default iterations are used
+//  - if it fits at the minimum iterations, the iterations are scaled down
+//  - otherwise the tests giving the most fault coverage per second are
+//    chosen greedily to fill the remaining time, and the rest are skipped
+//
+// When the budget expires, the current test is abandoned.
+//
+// The planner also chooses the order in which the tests are run in each pass.
+// The tests expected to find the most errors per second are run first, where
+// the expected yield of a test is its relative fault coverage plus the number
+// of errors it has found so far. Ties are broken by test number, so the order
+// is deterministic for a given history. Until there is a time for every
+// enabled test, measured or estimated, the tests are run in numbered order.
+
+#include "common.h"
+#include "unistd.h"
+
+#include "config.h"
+#include "test.h"
+#include "tests.h"
+
+#include "planner.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+// Limits the contribution of past errors to the expected yield of a test.
+#define MAX_YIELD_ERRORS    (1 << 20)
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    int             value;      // relative fault coverage
+    bool            scales;     // run time is proportional to the iterations
+} test_value_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static const test_value_t test_values[NUM_TEST_PATTERNS] = {
+    { 2, false },   // address test, walking ones
+    { 2, false },   // address test, own address in window
+    { 3, false },   // address test, own address + window
+    { 3, true  },   // moving inversions, 1s & 0s
+    { 3, true  },   // moving inversions, 8 bit pattern
+    { 4, true  },   // moving inversions, random pattern
+    { 3, true  },   // moving inversions, 32/64 bit pattern
+    { 3, true  },   // block move
+    { 4, true  },   // random number sequence
+    { 3, true  },   // modulo 20, random pattern
+    { 1, true  },   // bit fade
+    { 2, true  },   // cache working sets
+    { 2, true  },   // cache coherency, shared lines
+    { 3, true  },   // copy and checksum, random blocks
+    { 3, true  },   // random access, permuted lines
+    { 3, true  },   // March test
+    { 3, true  },   // moving inversions, wide word pattern
+    { 4, true  },   // row hammer, adjacent row pairs
+};
+
+static bool         active = false;
+
+// The position of each test in the order for the current pass.
+static int          pass_order[NUM_TEST_PATTERNS];
+static int          order_position[NUM_TEST_PATTERNS];
+
+static uint64_t     deadline = 0;
+
+static uint64_t     test_start_time = 0;
+
+static uint64_t     measured_us[NUM_TEST_PATTERNS];
+static int          measured_iterations[NUM_TEST_PATTERNS];
+
+// Used to convert tick counts to time for tests not yet measured.
+static uint64_t     total_us    = 0;
+static uint64_t     total_ticks = 0;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static uint64_t scale(uint64_t time, int test, int iterations, int base_iterations)
+{
+    if (!test_values[test].scales) {
+        return time;
+    }
+    return time * iterations / base_iterations;
+}
+
+static uint64_t estimated_time(int test, int iterations)
+{
+    if (measured_iterations[test] > 0) {
+        return scale(measured_us[test], test, iterations, measured_iterations[test]);
+    }
+    if (total_ticks > 0) {
+        pass_type_t pass_type = (pass_num == 0) ? FAST_PASS : FULL_PASS;
+        uint64_t time = total_us * ticks_per_test[pass_type][test] / total_ticks;
+        return scale(time, test, iterations, planner_default_iterations(test));
+    }
+    // No information yet, so assume it fits.
+    return 0;
+}
+
+static uint64_t expected_yield(int test)
+{
+    int errors = test_list[test].errors;
+    if (errors > MAX_YIELD_ERRORS) {
+        errors = MAX_YIELD_ERRORS;
+    }
+    return test_values[test].value + errors;
+}
+
+// Returns true if the time taken by the test has been measured or can be
+// estimated from the other measurements.
+static bool time_known(int test)
+{
+    return measured_iterations[test] > 0 || total_ticks > 0;
+}
+
+// Returns true if test1 should be run before test2.
+static bool run_before(int test1, int test2)
+{
+    uint64_t time1 = estimated_time(test1, planner_default_iterations(test1)) + 1;
+    uint64_t time2 = estimated_time(test2, planner_default_iterations(test2)) + 1;
+    // Compare yield per second without dividing.
+    uint64_t rate1 = expected_yield(test1) * time2;
+    uint64_t rate2 = expected_yield(test2) * time1;
+    if (rate1 != rate2) {
+        return rate1 > rate2;
+    }
+    return test1 < test2;
+}
+
+// Returns true if the test is amongst those with the highest coverage per
+// second that can be fitted into the remaining time at the minimum iterations.
+static bool worth_running(int test, uint64_t remaining)
+{
+    bool chosen[NUM_TEST_PATTERNS];
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        chosen[i] = false;
+    }
+
+    while (true) {
+        int best = -1;
+        uint64_t best_time = 0;
+        for (int k = order_position[test]; k < NUM_TEST_PATTERNS; k++) {
+            int i = pass_order[k];
+            if (!test_list[i].enabled || chosen[i]) {
+                continue;
+            }
+            uint64_t time = estimated_time(i, 1) + 1;
+            // Compare value per second without dividing.
+            if (best < 0 || test_values[i].value * best_time > test_values[best].value * time) {
+                best = i;
+                best_time = time;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        chosen[best] = true;
+        if (best_time <= remaining) {
+            remaining -= best_time;
+            if (best == test) {
+                return true;
+            }
+        } else if (best == test) {
+            return false;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void planner_init(void)
+{
+    if (time_budget == 0 || active) {
+        return;
+    }
+    deadline = get_time_us() + (uint64_t)time_budget * 1000000;
+    active = true;
+}
+
+void planner_order_tests(int order[])
+{
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        order[i] = i;
+    }
+    bool all_timed = true;
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        if (test_list[i].enabled && !time_known(i)) {
+            all_timed = false;
+        }
+    }
+    if (enable_test_order && all_timed) {
+        // Insertion sort, as the list is short.
+        for (int i = 1; i < NUM_TEST_PATTERNS; i++) {
+            int test = order[i];
+            int j = i;
+            while (j > 0 && run_before(test, order[j - 1])) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = test;
+        }
+    }
+    planner_use_order(order);
+}
+
+void planner_use_order(const int order[])
+{
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        pass_order[i] = order[i];
+        order_position[order[i]] = i;
+    }
+}
+
+int planner_default_iterations(int test)
+{
+    int iterations = test_list[test].iterations;
+    if (pass_num == 0) {
+        // Reduce iterations for a faster first pass.
+        iterations /= 3;
+    }
+    return iterations > 0 ? iterations : 1;
+}
+
+int planner_iterations(int test, int iterations)
+{
+    test_start_time = get_time_us();
+
+    if (!active) {
+        return iterations;
+    }
+    if (test_start_time >= deadline) {
+        return 0;
+    }
+    uint64_t remaining = deadline - test_start_time;
+
+    // Estimate the time needed to complete this pass.
+    uint64_t full_time = 0;
+    uint64_t min_time  = 0;
+    for (int k = order_position[test]; k < NUM_TEST_PATTERNS; k++) {
+        int i = pass_order[k];
+        if (test_list[i].enabled) {
+            full_time += estimated_time(i, planner_default_iterations(i));
+            min_time  += estimated_time(i, 1);
+        }
+    }
+    if (full_time <= remaining) {
+        return iterations;
+    }
+    if (min_time <= remaining) {
+        int scaled = iterations * remaining / full_time;
+        return scaled > 0 ? scaled : 1;
+    }
+    return worth_running(test, remaining) ? 1 : 0;
+}
+
+void planner_test_done(int test, int iterations)
+{
+    if (iterations <= 0 || planner_expired()) {
+        // The test was skipped or abandoned, so the timing is not useful.
+        return;
+    }
+    uint64_t elapsed = get_time_us() - test_start_time;
+
+    measured_us[test]         = elapsed;
+    measured_iterations[test] = iterations;
+
+    pass_type_t pass_type = (pass_num == 0) ? FAST_PASS : FULL_PASS;
+    total_us    += elapsed;
+    total_ticks += scale(ticks_per_test[pass_type][test], test, iterations, planner_default_iterations(test));
+}
+
+bool planner_expired(void)
+{
+    return active && get_time_us() >= deadline;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef PLANNER_H
+#define PLANNER_H
+/**
+ * \file
+ *
+ * Provides a run planner that fits the tests into a wall-clock time budget,
+ * using the measured time taken by each test to choose which tests are run
+ * and how many iterations each test performs.
+ */
+
+#include <stdbool.h>
+
+/**
+ * Starts the time budget, if one has been set and it has not already been
+ * started. Called at the start of each (non-dummy) run.
+ */
+void planner_init(void);
+
+/**
+ * Fills order with the test numbers in the order they should be run in the
+ * next pass, and records that order for use in planning the pass. Unless
+ * automatic ordering has been disabled, the tests expected to find the most
+ * errors per second are placed first.
+ */
+void planner_order_tests(int order[]);
+
+/**
+ * Records the order in which the tests will be run in the current pass, when
+ * this is not chosen by planner_order_tests (e.g. when resuming a pass).
+ */
+void planner_use_order(const int order[]);
+
+/**
+ * Returns the default number of iterations for the specified test in the
+ * current pass. This is reduced for the first pass, but is never less than 1.
+ */
+int planner_default_iterations(int test);
+
+/**
+ * Returns the number of iterations to be used for the specified test, given
+ * the default number of iterations for this pass, or 0 if the test should be
+ * skipped in this pass. Also records the test start time.
+ */
+int planner_iterations(int test, int iterations);
+
+/**
+ * Records the time taken by the specified test, which has just completed
+ * using the specified number of iterations.
+ */
+void planner_test_done(int test, int iterations);
+
+/**
+ * Returns true if a time budget has been set and has been used up.
+ */
+bool planner_expired(void);
+
+#endif // PLANNER_H
@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: GPL-2.0
+// Retests the cache lines in which data errors have been found, to give a
+// quick verdict on each fault without waiting for another pass. Each line
+// and the same line in the neighbouring DRAM rows is subjected to a short
+// battery of patterns, written in both polarities and read back after the
+// line has been flushed from the CPU caches, and this is repeated a number
+// of times:
+//
+//  - reproducible      the line failed in every round
+//  - intermittent      the line failed in some rounds
+//  - not reproduced    the line never failed
+//
+// Where the CPU has no instruction to flush a single cache line, the read
+// back would come from the cache rather than from memory, so no verdict is
+// given and the line is marked as unsupported instead.
+//
+// The physical to DRAM row mapping is not known, so the row neighbours are
+// taken to be the lines at the same offset one typical row size (8KB) below
+// and above the failing line.
+//
+// Lines in the background bit fade region are not touched while the region
+// is in use, as that would be reported as fade errors. A failing line in the
+// region is left pending until the region is released, and a neighbour in the
+// region is skipped.
+
+#include "common.h"
+
+#include "cache.h"
+#include "vmem.h"
+
+#include "bgfade.h"
+#include "config.h"
+#include "display.h"
+#include "error.h"
+#include "retest.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MAX_RETEST_LINES    32
+
+#define LINE_SIZE           64
+#define LINE_WORDS          (LINE_SIZE / sizeof(testword_t))
+
+#define ROW_PAGES           2       // 8KB
+
+#define RETEST_ROUNDS       16
+
+#if TESTWORD_WIDTH > 32
+#define PATTERN_5A          UINT64_C(0x5555555555555555)
+#else
+#define PATTERN_5A          0x55555555
+#endif
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uintptr_t           page;
+    uintptr_t           offset;         // of the first word in the line
+    int                 test;
+    testword_t          good;
+    testword_t          bad;
+    retest_verdict_t    verdict;
+    int                 failed_rounds;
+    int                 neighbour_errors;
+} retest_line_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static retest_line_t    lines[MAX_RETEST_LINES];
+static int              num_lines = 0;
+
+static int              num_verdicts[NUM_RETEST_VERDICTS];
+
+static const char       *verdict_names[NUM_RETEST_VERDICTS] = {
+    "pending",
+    "reproducible",
+    "intermittent",
+    "not reproduced",
+    "unsupported"
+};
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static bool page_is_fading(uintptr_t page)
+{
+    uintptr_t start, end;
+    return bgfade_region(&start, &end) && page >= start && page < end;
+}
+
+static bool page_is_tested(uintptr_t page)
+{
+    if (page < pm_limit_lower || page >= pm_limit_upper) {
+        return false;
+    }
+    if (page_is_fading(page)) {
+        return false;
+    }
+    for (int i = 0; i < pm_map_size; i++) {
+        if (page >= pm_map[i].start && page < pm_map[i].end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static testword_t *map_line(uintptr_t page, uintptr_t offset)
+{
+    if (!page_is_tested(page) || !map_window(page)) {
+        return NULL;
+    }
+    return (testword_t *)((uintptr_t)first_word_mapping(page) + offset);
+}
+
+#if CACHE_FLUSH_LINE
+
+// Writes the pattern to the line, alternating the polarity of adjacent words
+// if checkerboard is set, then reads it back after flushing the line from the
+// caches. Returns the number of words in error.
+static int check_line(testword_t *line, testword_t pattern, bool checkerboard)
+{
+    testword_t value = pattern;
+    for (size_t i = 0; i < LINE_WORDS; i++) {
+        write_word(line + i, value);
+        if (checkerboard) {
+            value = ~value;
+        }
+    }
+
+    cache_flush_line(line);
+    cache_flush_wait();
+
+    int errors = 0;
+    value = pattern;
+    for (size_t i = 0; i < LINE_WORDS; i++) {
+        if (read_word(line + i) != value) {
+            errors++;
+        }
+        if (checkerboard) {
+            value = ~value;
+        }
+    }
+    return errors;
+}
+
+static int run_battery(testword_t *line, testword_t good)
+{
+    const testword_t patterns[] = { 0, PATTERN_5A, good };
+
+    int errors = 0;
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        errors += check_line(line,  patterns[i], false);
+        errors += check_line(line, ~patterns[i], false);
+        errors += check_line(line,  patterns[i], true);
+        errors += check_line(line, ~patterns[i], true);
+    }
+    return errors;
+}
+
+#endif
+
+static void retest_line(retest_line_t *entry)
+{
+    testword_t *line = map_line(entry->page, entry->offset);
+    if (line == NULL) {
+        return;
+    }
+
+#if !CACHE_FLUSH_LINE
+    entry->verdict = RETEST_UNSUPPORTED;
+#else
+    entry->failed_rounds    = 0;
+    entry->neighbour_errors = 0;
+    for (int round = 0; round < RETEST_ROUNDS; round++) {
+        line = map_line(entry->page, entry->offset);
+        if (run_battery(line, entry->good) > 0) {
+            entry->failed_rounds++;
+        }
+        for (int direction = -1; direction <= 1; direction += 2) {
+            uintptr_t page = entry->page + direction * ROW_PAGES;
+            testword_t *neighbour = map_line(page, entry->offset);
+            if (neighbour != NULL) {
+                entry->neighbour_errors += run_battery(neighbour, entry->good);
+            }
+        }
+    }
+
+    if (entry->failed_rounds == RETEST_ROUNDS) {
+        entry->verdict = RETEST_REPRODUCIBLE;
+    } else if (entry->failed_rounds > 0) {
+        entry->verdict = RETEST_INTERMITTENT;
+    } else {
+        entry->verdict = RETEST_NOT_REPRODUCED;
+    }
+#endif
+    num_verdicts[entry->verdict]++;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void retest_init(void)
+{
+    num_lines = 0;
+    for (int i = 0; i < NUM_RETEST_VERDICTS; i++) {
+        num_verdicts[i] = 0;
+    }
+}
+
+void retest_enqueue(uintptr_t page, uintptr_t offset, testword_t good, testword_t bad)
+{
+    offset &= ~(uintptr_t)(LINE_SIZE - 1);
+
+    retest_line_t *entry = NULL;
+    for (int i = 0; i < num_lines; i++) {
+        if (lines[i].page == page && lines[i].offset == offset) {
+            entry = &lines[i];
+            break;
+        }
+    }
+    if (entry != NULL) {
+        if (entry->verdict == RETEST_PENDING) {
+            return;
+        }
+        // The line has failed again, so retest it with the new context.
+        num_verdicts[entry->verdict]--;
+    } else {
+        if (num_lines == MAX_RETEST_LINES) {
+            return;
+        }
+        entry = &lines[num_lines++];
+    }
+
+    entry->page             = page;
+    entry->offset           = offset;
+    entry->test             = test_num;
+    entry->good             = good;
+    entry->bad              = bad;
+    entry->verdict          = RETEST_PENDING;
+    entry->failed_rounds    = 0;
+    entry->neighbour_errors = 0;
+    num_verdicts[RETEST_PENDING]++;
+}
+
+void retest_run(void)
+{
+    if (num_verdicts[RETEST_PENDING] == 0) {
+        return;
+    }
+
+    for (int i = 0; i < num_lines; i++) {
+        retest_line_t *entry = &lines[i];
+        if (entry->verdict != RETEST_PENDING || page_is_fading(entry->page)) {
+            continue;
+        }
+        retest_line(entry);
+        if (entry->verdict == RETEST_PENDING) {
+            // The line is no longer accessible, so give up on it.
+            entry->verdict = RETEST_NOT_REPRODUCED;
+            num_verdicts[RETEST_NOT_REPRODUCED]++;
+        }
+        num_verdicts[RETEST_PENDING]--;
+
+        if (error_mode == ERROR_MODE_ADDRESS && entry->verdict == RETEST_UNSUPPORTED) {
+            scroll();
+            display_scrolled_message(0, " Retest %2i   %09x%03x  %s, no cache line flush",
+                                     entry->test, entry->page, entry->offset,
+                                     verdict_names[entry->verdict]);
+        } else if (error_mode == ERROR_MODE_ADDRESS) {
+            scroll();
+            display_scrolled_message(0, " Retest %2i   %09x%03x  %s, failed %i/%i rounds, %i row errors",
+                                     entry->test, entry->page, entry->offset,
+                                     verdict_names[entry->verdict],
+                                     entry->failed_rounds, RETEST_ROUNDS,
+                                     entry->neighbour_errors);
+        }
+    }
+}
+
+int retest_num_verdicts(retest_verdict_t verdict)
+{
+    return num_verdicts[verdict];
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef RETEST_H
+#define RETEST_H
+/**
+ * \file
+ *
+ * Provides a queue of failing cache lines that are retested with a focused
+ * battery of patterns at the end of each test, to classify each fault as
+ * reproducible, intermittent, or not reproduced.
+ */
+
+#include <stdint.h>
+
+#include "test.h"
+
+/**
+ * The retest verdicts.
+ */
+typedef enum {
+    RETEST_PENDING,
+    RETEST_REPRODUCIBLE,
+    RETEST_INTERMITTENT,
+    RETEST_NOT_REPRODUCED,
+    RETEST_UNSUPPORTED,
+    NUM_RETEST_VERDICTS
+} retest_verdict_t;
+
+/**
+ * Clears the retest queue.
+ */
+void retest_init(void);
+
+/**
+ * Adds the cache line containing the failing address to the retest queue,
+ * together with the expected and actual values. A line that already has a
+ * verdict is queued again. New lines are ignored once the queue is full.
+ */
+void retest_enqueue(uintptr_t page, uintptr_t offset, testword_t good, testword_t bad);
+
+/**
+ * Retests all the pending lines in the queue and their row neighbours, and
+ * displays the verdicts. Must only be called by the master CPU when all other
+ * CPUs are idle.
+ */
+void retest_run(void);
+
+/**
+ * Returns the number of queued lines that have been given the specified
+ * verdict.
+ */
+int retest_num_verdicts(retest_verdict_t verdict);
+
+#endif // RETEST_H
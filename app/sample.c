@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0
+// Implements the sampling mode. The physical memory within the user-specified
+// limits is divided into units of a power-of-two number of pages, aligned to
+// their size so that no unit straddles a test window. A unit never straddles
+// a physical memory segment either, so the units at the ends of a segment may
+// be smaller.
+//
+// Each physical memory segment is treated as a separate stratum, from which
+// the configured percentage of units is chosen at the start of each pass. The
+// units covered by the fewest of the enabled tests are chosen first, with ties
+// broken at random, so successive passes sweep through the whole memory.
+
+#include "common.h"
+
+#include "memsize.h"
+#include "pmem.h"
+#include "screen.h"
+#include "vmem.h"
+
+#include "config.h"
+#include "error.h"
+#include "test.h"
+#include "tests.h"
+
+#include "sample.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MAX_SAMPLE_UNITS    2048
+
+// Enough to keep the number of runs in a window within the virtual memory map.
+#define MIN_UNITS_PER_WINDOW    64
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uintptr_t       start;      // first page
+    uintptr_t       end;        // last page + 1
+    uint32_t        coverage;   // bit N set if covered by test N
+} sample_unit_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static sample_unit_t    units[MAX_SAMPLE_UNITS];
+static bool             selected[MAX_SAMPLE_UNITS];
+static int              num_units = 0;
+
+static uint16_t         candidates[MAX_SAMPLE_UNITS];
+
+// The first unit in each stratum, plus an end marker.
+static int              stratum_start[MAX_MEM_SEGMENTS + 1];
+static int              num_strata = 0;
+
+static uint32_t         rand_state = 1;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static uint32_t next_random(void)
+{
+    // Xorshift32.
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static int coverage_score(const sample_unit_t *unit)
+{
+    int score = 0;
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        if (test_list[i].enabled && (unit->coverage & (1 << i))) {
+            score++;
+        }
+    }
+    return score;
+}
+
+static void select_from_stratum(int first, int last)
+{
+    int wanted = ((last - first) * sample_percent + 99) / 100;
+
+    if (enable_adaptive && error_count > 0) {
+        // Always select the units containing or adjacent to failing pages.
+        // These count towards the quota, so clean units are sampled less.
+        for (int i = first; i < last; i++) {
+            uintptr_t start = units[(i > first)    ? i - 1 : i].start;
+            uintptr_t end   = units[(i < last - 1) ? i + 1 : i].end;
+            if (error_pages_in_range(start, end)) {
+                selected[i] = true;
+                wanted--;
+            }
+        }
+    }
+
+    for (int score = 0; wanted > 0 && score <= NUM_TEST_PATTERNS; score++) {
+        int num_candidates = 0;
+        for (int i = first; i < last; i++) {
+            if (!selected[i] && coverage_score(&units[i]) == score) {
+                candidates[num_candidates++] = i;
+            }
+        }
+        // Partial Fisher-Yates shuffle to pick the units at random.
+        for (int i = 0; wanted > 0 && i < num_candidates; i++, wanted--) {
+            int j = i + next_random() % (num_candidates - i);
+            uint16_t chosen = candidates[j];
+            candidates[j] = candidates[i];
+            selected[chosen] = true;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void sample_init(void)
+{
+    num_units  = 0;
+    num_strata = 0;
+
+    uintptr_t total_pages = 0;
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t seg_start = (pm_map[i].start > pm_limit_lower) ? pm_map[i].start : pm_limit_lower;
+        uintptr_t seg_end   = (pm_map[i].end   < pm_limit_upper) ? pm_map[i].end   : pm_limit_upper;
+        if (seg_start < seg_end) {
+            total_pages += seg_end - seg_start;
+        }
+    }
+
+    // Each segment may add two part-filled units.
+    uintptr_t max_units = MAX_SAMPLE_UNITS - 2 * pm_map_size;
+    uintptr_t min_unit_pages = total_pages / MIN_UNITS_PER_WINDOW;
+    if (min_unit_pages > VM_WINDOW_SIZE / MIN_UNITS_PER_WINDOW) {
+        min_unit_pages = VM_WINDOW_SIZE / MIN_UNITS_PER_WINDOW;
+    }
+    uintptr_t unit_pages = 1;
+    while (unit_pages < min_unit_pages || total_pages / unit_pages > max_units) {
+        unit_pages *= 2;
+    }
+
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t seg_start = (pm_map[i].start > pm_limit_lower) ? pm_map[i].start : pm_limit_lower;
+        uintptr_t seg_end   = (pm_map[i].end   < pm_limit_upper) ? pm_map[i].end   : pm_limit_upper;
+        if (seg_start >= seg_end) {
+            continue;
+        }
+        stratum_start[num_strata++] = num_units;
+        uintptr_t start = seg_start;
+        while (start < seg_end && num_units < MAX_SAMPLE_UNITS) {
+            uintptr_t end = (start + unit_pages) & ~(unit_pages - 1);
+            if (end > seg_end) {
+                end = seg_end;
+            }
+            units[num_units].start    = start;
+            units[num_units].end      = end;
+            units[num_units].coverage = 0;
+            selected[num_units] = false;
+            num_units++;
+            start = end;
+        }
+    }
+    stratum_start[num_strata] = num_units;
+
+    rand_state = (uint32_t)io_read(AM_TIMER_UPTIME).us | 1;
+}
+
+void sample_select(void)
+{
+    for (int i = 0; i < num_units; i++) {
+        selected[i] = false;
+    }
+    for (int i = 0; i < num_strata; i++) {
+        select_from_stratum(stratum_start[i], stratum_start[i + 1]);
+    }
+}
+
+bool sample_next_run(uintptr_t *page, uintptr_t limit, uintptr_t *start, uintptr_t *end)
+{
+    // Find the first unit that ends above the page.
+    int lo = 0;
+    int hi = num_units;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (units[mid].end <= *page) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    int i = lo;
+    while (i < num_units && units[i].start < limit && !selected[i]) {
+        i++;
+    }
+    if (i == num_units || units[i].start >= limit) {
+        return false;
+    }
+    *start = (units[i].start > *page) ? units[i].start : *page;
+
+    // Merge with any following units that are contiguous and also selected.
+    while (i + 1 < num_units && selected[i + 1] && units[i + 1].start == units[i].end) {
+        i++;
+    }
+    *end  = (units[i].end < limit) ? units[i].end : limit;
+    *page = *end;
+    return true;
+}
+
+void sample_test_done(int test)
+{
+    for (int i = 0; i < num_units; i++) {
+        if (selected[i]) {
+            units[i].coverage |= 1 << test;
+        }
+    }
+}
+
+void sample_report(void)
+{
+    uint32_t enabled_tests = 0;
+    for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+        if (test_list[i].enabled) {
+            enabled_tests |= 1 << i;
+        }
+    }
+
+    uint64_t total_pages   = 0;
+    uint64_t covered_pages = 0;
+    for (int i = 0; i < num_units; i++) {
+        uintptr_t pages = units[i].end - units[i].start;
+        total_pages += pages;
+        if ((units[i].coverage & enabled_tests) == enabled_tests) {
+            covered_pages += pages;
+        }
+    }
+    if (total_pages == 0) {
+        return;
+    }
+
+    printf("\033[%d;1H\nsample pass %i units %i coverage %i%%\n", SCREEN_HEIGHT + 1,
+           pass_num, num_units, (int)(covered_pages * 100 / total_pages));
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SAMPLE_H
+#define SAMPLE_H
+/**
+ * \file
+ *
+ * Provides a sampling mode, where each pass tests a random subset of the
+ * physical memory, and a record of which parts of the memory have been
+ * tested by each test, so that later passes prefer the untested parts.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Divides the physical memory within the user-specified limits into sample
+ * units and clears the coverage record. Called at the start of each run.
+ */
+void sample_init(void);
+
+/**
+ * Selects the sample units to be tested in the next pass. The selection is
+ * stratified, taking the configured percentage of the units in each physical
+ * memory segment, and prefers the units that have been covered by the fewest
+ * of the enabled tests.
+ */
+void sample_select(void);
+
+/**
+ * Finds the next run of contiguous selected pages at or above *page and below
+ * limit. If found, stores its bounds in *start and *end, advances *page to
+ * *end, and returns true. Otherwise returns false.
+ */
+bool sample_next_run(uintptr_t *page, uintptr_t limit, uintptr_t *start, uintptr_t *end);
+
+/**
+ * Records that the specified test has covered all the units selected for
+ * this pass.
+ */
+void sample_test_done(int test);
+
+/**
+ * Writes the coverage achieved so far to the console stream.
+ */
+void sample_report(void);
+
+#endif // SAMPLE_H
@@ -79,6 +79,25 @@ extern spinlock_t *error_mutex;
  */
 typedef uintptr_t testword_t;
 
+#ifndef WIDEWORD_WIDTH
+/**
+ * The width (in bits) of the wide word used by the wide word tests. The
+ * default is the size of a cache line, which is also the size of a DDR
+ * burst. May be set to 128 or 256 at build time.
+ */
+#define WIDEWORD_WIDTH      512
+#endif
+/**
+ * The number of test words in a wide word.
+ */
+#define WIDEWORD_LANES      (WIDEWORD_WIDTH / TESTWORD_WIDTH)
+
+/**
+ * The wide word type, a vector of test words. Where the CPU has SIMD
+ * registers of a suitable size, the compiler uses them to hold wide words.
+ */
+typedef testword_t wideword_t __attribute__((vector_size(WIDEWORD_WIDTH / 8)));
+
 /**
  * A virtual memory segment descriptor.
  */
@@ -110,6 +129,10 @@ extern int test_num;
  * The current window number.
  */
 extern int window_num;
+/**
+ * The number of windows already tested in the current test stage.
+ */
+extern int windows_tested;
 
 /**
  * A flag indicating that testing should be restarted due to a configuration
@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0
+// Each CPU only ever writes to its own trace buffer, so no locks are needed
+// to add a record. The record count is updated after the record is written,
+// so a dump sees only complete records, although a record may be overwritten
+// while it is being dumped if the CPU that owns it is still running.
+
+#include "common.h"
+
+#include <stdarg.h>
+
+#include "print.h"
+
+#include "display.h"
+
+#include "trace.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define TRACE_MAX_ARGS      6
+
+#define TRACE_BUFFER_SIZE   256     // records per CPU
+
+#define MAX_SPEC_LENGTH     16
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t        time_us;
+    const char      *fmt;
+    uintptr_t       args[TRACE_MAX_ARGS];
+} trace_record_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static trace_record_t       trace_buffer[MAX_CPUS][TRACE_BUFFER_SIZE];
+
+static volatile uint32_t    trace_count[MAX_CPUS];  // records added since start
+
+static bool                 dumping = false;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+// Copies the conversion specification at fmt into spec. Returns a pointer to
+// the conversion character, or to the end of the string if there is none.
+static const char *parse_spec(const char *fmt, char *spec, bool *star)
+{
+    int length = 0;
+    *star = false;
+    spec[length++] = *fmt++;
+    while (*fmt != '\0' && length < MAX_SPEC_LENGTH - 2) {
+        char c = *fmt;
+        spec[length++] = c;
+        if (c == '*') {
+            *star = true;
+        } else if (c != '-' && c != 'S' && (c < '0' || c > '9')) {
+            break;
+        }
+        fmt++;
+    }
+    spec[length] = '\0';
+    return fmt;
+}
+
+static int format_arg(char *str, int size, const char *spec, char conversion, bool star, int width, uintptr_t value)
+{
+    switch (conversion) {
+      case 'c':
+      case 'i':
+        return star ? sprintk(str, size, spec, width, (int)value) : sprintk(str, size, spec, (int)value);
+      case 's':
+        return star ? sprintk(str, size, spec, width, (const char *)value) : sprintk(str, size, spec, (const char *)value);
+      case 'u':
+      case 'x':
+      case 'k':
+        return star ? sprintk(str, size, spec, width, value) : sprintk(str, size, spec, value);
+      default:
+        return sprintk(str, size, spec);
+    }
+}
+
+static int format_record(char *str, int size, const trace_record_t *record)
+{
+    int length = 0;
+    int arg = 0;
+    const char *fmt = record->fmt;
+    while (*fmt != '\0' && length < size - 1) {
+        if (*fmt != '%') {
+            str[length++] = *fmt++;
+            continue;
+        }
+        char spec[MAX_SPEC_LENGTH];
+        bool star;
+        fmt = parse_spec(fmt, spec, &star);
+        if (*fmt == '\0') {
+            break;
+        }
+        char conversion = *fmt++;
+        int width = 0;
+        if (star) {
+            width = (arg < TRACE_MAX_ARGS) ? (int)record->args[arg++] : 0;
+        }
+        uintptr_t value = 0;
+        if (conversion != '%') {
+            value = (arg < TRACE_MAX_ARGS) ? record->args[arg++] : 0;
+            if (conversion == 's' && value == 0) {
+                value = (uintptr_t)"?";
+            }
+        }
+        length += format_arg(str + length, size - length, spec, conversion, star, width, value);
+    }
+    str[length] = '\0';
+    return length;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void do_trace(int my_cpu, const char *fmt, ...)
+{
+    if (my_cpu < 0 || my_cpu >= MAX_CPUS) {
+        return;
+    }
+
+    uint32_t n = trace_count[my_cpu];
+    trace_record_t *record = &trace_buffer[my_cpu][n % TRACE_BUFFER_SIZE];
+
+    record->time_us = io_read(AM_TIMER_UPTIME).us;
+    record->fmt     = fmt;
+
+    // Collect the arguments according to the types given by the format.
+    va_list args;
+    va_start(args, fmt);
+    int num_args = 0;
+    while (*fmt != '\0' && num_args < TRACE_MAX_ARGS) {
+        if (*fmt++ != '%') {
+            continue;
+        }
+        if (*fmt == '%') {
+            fmt++;
+            continue;
+        }
+        while (*fmt == '-' || *fmt == 'S' || *fmt == '*' || (*fmt >= '0' && *fmt <= '9')) {
+            if (*fmt == '*' && num_args < TRACE_MAX_ARGS) {
+                record->args[num_args++] = va_arg(args, int);
+            }
+            fmt++;
+        }
+        if (num_args == TRACE_MAX_ARGS) {
+            break;
+        }
+        switch (*fmt) {
+          case 'c':
+          case 'i':
+            record->args[num_args++] = va_arg(args, int);
+            break;
+          case 's':
+            record->args[num_args++] = (uintptr_t)va_arg(args, const char *);
+            break;
+          case 'u':
+          case 'x':
+          case 'k':
+            record->args[num_args++] = va_arg(args, uintptr_t);
+            break;
+          default:
+            continue;
+        }
+        fmt++;
+    }
+    va_end(args);
+    while (num_args < TRACE_MAX_ARGS) {
+        record->args[num_args++] = 0;
+    }
+
+    // Make sure the record is complete before it is counted.
+    __sync_synchronize();
+    trace_count[my_cpu] = n + 1;
+}
+
+void trace_dump(void)
+{
+    // Guard against a recursive call from check_input() while we scroll.
+    if (dumping) {
+        return;
+    }
+    dumping = true;
+
+    uint32_t next[MAX_CPUS];
+    uint32_t last[MAX_CPUS];
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        last[cpu] = trace_count[cpu];
+        next[cpu] = (last[cpu] > TRACE_BUFFER_SIZE) ? last[cpu] - TRACE_BUFFER_SIZE : 0;
+    }
+
+    clear_message_area();
+    display_pinned_message(0, 0, "CPU      Time  Trace");
+    display_pinned_message(1, 0, "--- ---------  -----------------------------------------------------------------");
+
+    while (true) {
+        // Merge the buffers, taking the oldest remaining record each time.
+        int cpu = -1;
+        for (int i = 0; i < MAX_CPUS; i++) {
+            if (next[i] == last[i]) {
+                continue;
+            }
+            const trace_record_t *record = &trace_buffer[i][next[i] % TRACE_BUFFER_SIZE];
+            if (cpu < 0 || record->time_us < trace_buffer[cpu][next[cpu] % TRACE_BUFFER_SIZE].time_us) {
+                cpu = i;
+            }
+        }
+        if (cpu < 0) {
+            break;
+        }
+        const trace_record_t *record = &trace_buffer[cpu][next[cpu] % TRACE_BUFFER_SIZE];
+        next[cpu]++;
+
+        char text[SCREEN_WIDTH - 14];
+        format_record(text, sizeof(text), record);
+
+        uint32_t ms = record->time_us / 1000;
+        scroll();
+        display_scrolled_message(0, "%3i %5i.%03i  %s", cpu, (int)(ms / 1000), (int)(ms % 1000), text);
+    }
+
+    dumping = false;
+}
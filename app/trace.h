@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TRACE_H
+#define TRACE_H
+/**
+ * \file
+ *
+ * Provides an in-memory trace buffer for each CPU. Each trace record holds a
+ * timestamp, the format string (which identifies the type of record), and the
+ * raw argument values. Adding a record takes no locks and displays nothing,
+ * so tracing has little effect on the test timings. The records are only
+ * formatted when the buffers are dumped.
+ */
+
+#include <stdbool.h>
+
+#include "config.h"
+
+/**
+ * Adds a trace record for the specified CPU if tracing is enabled.
+ */
+#define trace(my_cpu, ...) \
+    if (enable_trace) do_trace(my_cpu, __VA_ARGS__)
+
+/**
+ * Adds a trace record to the trace buffer for my_cpu, overwriting the oldest
+ * record if the buffer is full. Accepts the same formats as printk, but only
+ * the first few arguments (including '*' field widths) are recorded. The
+ * format string and any string arguments must remain valid until the record
+ * is dumped, so should be string literals.
+ */
+void do_trace(int my_cpu, const char *fmt, ...);
+
+/**
+ * Displays the records in all the trace buffers in time order, in the
+ * scrolling message area.
+ */
+void trace_dump(void);
+
+#endif // TRACE_H
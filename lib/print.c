@@ -12,10 +12,38 @@
 
 #define BUFFER_SIZE 64
 
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+// The destination of formatted output. This is passed down to each function
+// rather than held in a global, as other CPUs may print at the same time.
+typedef struct {
+    char    *buffer;    // if NULL, output goes to the screen, otherwise to
+    int     size;       // this buffer, using the column number as the index
+} output_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static const output_t screen_output = { NULL, 0 };
+
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
 
+static void put_char(const output_t *out, int row, int col, char c)
+{
+    if (out->buffer != NULL) {
+        if (col < out->size - 1) {
+            out->buffer[col] = c;
+        }
+    } else {
+        print_char(row, col, c);
+    }
+}
+
 static int int_to_dec_str(char buffer[], int value, int min_length, int max_length)
 {
     bool negative = (value < 0);
@@ -68,7 +96,7 @@ static int min_str_length(int field_length, bool pad)
     return (field_length > 0 && pad) ? field_length : 1;
 }
 
-static int print_in_field(int row, int col, const char buffer[], int buffer_length, int field_length, bool left)
+static int print_in_field(const output_t *out, int row, int col, const char buffer[], int buffer_length, int field_length, bool left)
 {
     bool reversed = false;
     if (buffer_length < 0) {
@@ -77,74 +105,56 @@ static int print_in_field(int row, int col, const char buffer[], int buffer_leng
     }
     if (!left) {
         while (field_length > buffer_length) {
-            print_char(row, col++, ' ');
+            put_char(out, row, col++, ' ');
             field_length--;
         }
     }
     if (reversed) {
         for (int i = buffer_length - 1; i >= 0; i--) {
-            print_char(row, col++, buffer[i]);
+            put_char(out, row, col++, buffer[i]);
         }
     } else {
         for (int i = 0; i < buffer_length; i++) {
-            print_char(row, col++, buffer[i]);
+            put_char(out, row, col++, buffer[i]);
         }
     }
     if (left) {
         while (field_length > buffer_length) {
-            print_char(row, col++, ' ');
+            put_char(out, row, col++, ' ');
             field_length--;
         }
     }
     return col;
 }
 
-//------------------------------------------------------------------------------
-// Public Functions
-//------------------------------------------------------------------------------
-
-int printc(int row, int col, const char c)
-{
-    print_char(row, col++, c);
-    return col;
-}
-
-int prints(int row, int col, const char *str)
-{
-    while (*str) {
-        print_char(row, col++, *str++);
-    }
-    return col;
-}
-
-int printi(int row, int col, int value, int field_length, bool pad, bool left)
+static int print_int(const output_t *out, int row, int col, int value, int field_length, bool pad, bool left)
 {
     char buffer[BUFFER_SIZE];
 
     int length = int_to_dec_str(buffer, value, min_str_length(field_length, pad), BUFFER_SIZE);
 
-    return print_in_field(row, col, buffer, -length, field_length, left);
+    return print_in_field(out, row, col, buffer, -length, field_length, left);
 }
 
-int printu(int row, int col, uintptr_t value, int field_length, bool pad, bool left)
+static int print_uint(const output_t *out, int row, int col, uintptr_t value, int field_length, bool pad, bool left)
 {
     char buffer[BUFFER_SIZE];
 
     int length = uint_to_dec_str(buffer, value, min_str_length(field_length, pad), BUFFER_SIZE);
 
-    return print_in_field(row, col, buffer, -length, field_length, left);
+    return print_in_field(out, row, col, buffer, -length, field_length, left);
 }
 
-int printx(int row, int col, uintptr_t value, int field_length, bool pad, bool left)
+static int print_hex(const output_t *out, int row, int col, uintptr_t value, int field_length, bool pad, bool left)
 {
     char buffer[BUFFER_SIZE];
 
     int length = uint_to_hex_str(buffer, value, min_str_length(field_length, pad), BUFFER_SIZE);
 
-    return print_in_field(row, col, buffer, -length, field_length, left);
+    return print_in_field(out, row, col, buffer, -length, field_length, left);
 }
 
-int printkk(int row, int col, uintptr_t value, int field_length, bool pad, bool left, bool add_space)
+static int print_kk(const output_t *out, int row, int col, uintptr_t value, int field_length, bool pad, bool left, bool add_space)
 {
     static const char suffix[4] = { 'K', 'M', 'G', 'T' };
 
@@ -193,30 +203,19 @@ int printkk(int row, int col, uintptr_t value, int field_length, bool pad, bool
     }
     length += uint_to_dec_str(&buffer[length], value, min_str_length(whole_length, pad), BUFFER_SIZE - length);
 
-    return print_in_field(row, col, buffer, -length, field_length, left);
-}
-
-int printk(int row, int col, const char *fmt, ...)
-{
-    va_list args;
-
-    va_start(args, fmt);
-    int end_col = vprintf(row, col, fmt, args);
-    va_end(args);
-
-    return end_col;
+    return print_in_field(out, row, col, buffer, -length, field_length, left);
 }
 
-int vprintf(int row, int col, const char *fmt, va_list args)
+static int print_formatted(const output_t *out, int row, int col, const char *fmt, va_list args)
 {
     while (*fmt) {
         if (*fmt != '%') {
-            print_char(row, col++, *fmt++);
+            put_char(out, row, col++, *fmt++);
             continue;
         }
         fmt++;
         if (*fmt == '%') {
-            print_char(row, col++, *fmt++);
+            put_char(out, row, col++, *fmt++);
             continue;
         }
 
@@ -253,23 +252,23 @@ int vprintf(int row, int col, const char *fmt, va_list args)
           case 'c': {
             char buffer[1];
             buffer[0] = va_arg(args, int);
-            col = print_in_field(row, col, buffer, 1, length, left);
+            col = print_in_field(out, row, col, buffer, 1, length, left);
           } break;
           case 's': {
             const char *str = va_arg(args, char *);
-            col = print_in_field(row, col, str, strlen(str), length, left);
+            col = print_in_field(out, row, col, str, strlen(str), length, left);
           } break;
           case 'i':
-            col = printi(row, col, va_arg(args, int), length, pad, left);
+            col = print_int(out, row, col, va_arg(args, int), length, pad, left);
             break;
           case 'u':
-            col = printu(row, col, va_arg(args, uintptr_t), length, pad, left);
+            col = print_uint(out, row, col, va_arg(args, uintptr_t), length, pad, left);
             break;
           case 'x':
-            col = printx(row, col, va_arg(args, uintptr_t), length, pad, left);
+            col = print_hex(out, row, col, va_arg(args, uintptr_t), length, pad, left);
             break;
           case 'k':
-            col = printkk(row, col, va_arg(args, uintptr_t), length, pad, left, add_space);
+            col = print_kk(out, row, col, va_arg(args, uintptr_t), length, pad, left, add_space);
             break;
         }
         fmt++;
@@ -277,3 +276,84 @@ int vprintf(int row, int col, const char *fmt, va_list args)
 
     return col;
 }
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+int printc(int row, int col, const char c)
+{
+    print_char(row, col++, c);
+    return col;
+}
+
+int prints(int row, int col, const char *str)
+{
+    while (*str) {
+        print_char(row, col++, *str++);
+    }
+    return col;
+}
+
+int printi(int row, int col, int value, int field_length, bool pad, bool left)
+{
+    return print_int(&screen_output, row, col, value, field_length, pad, left);
+}
+
+int printu(int row, int col, uintptr_t value, int field_length, bool pad, bool left)
+{
+    return print_uint(&screen_output, row, col, value, field_length, pad, left);
+}
+
+int printx(int row, int col, uintptr_t value, int field_length, bool pad, bool left)
+{
+    return print_hex(&screen_output, row, col, value, field_length, pad, left);
+}
+
+int printkk(int row, int col, uintptr_t value, int field_length, bool pad, bool left, bool add_space)
+{
+    return print_kk(&screen_output, row, col, value, field_length, pad, left, add_space);
+}
+
+int printk(int row, int col, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int end_col = vprintf(row, col, fmt, args);
+    va_end(args);
+
+    return end_col;
+}
+
+int vprintf(int row, int col, const char *fmt, va_list args)
+{
+    return print_formatted(&screen_output, row, col, fmt, args);
+}
+
+int sprintk(char *str, int size, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int length = vsprintk(str, size, fmt, args);
+    va_end(args);
+
+    return length;
+}
+
+int vsprintk(char *str, int size, const char *fmt, va_list args)
+{
+    if (size < 1) {
+        return 0;
+    }
+    output_t out = { str, size };
+    int length = print_formatted(&out, 0, 0, fmt, args);
+
+    if (length > size - 1) {
+        length = size - 1;
+    }
+    str[length] = '\0';
+
+    return length;
+}
@@ -88,4 +88,16 @@ int printk(int row, int col, const char *fmt, ...);
  */
 int vprintf(int row, int col, const char *fmt, va_list args);
 
+/**
+ * Formats a string as for printk, but stores it in the supplied buffer
+ * instead of printing it on screen. At most size-1 characters are stored,
+ * followed by a terminating null. Returns the length of the stored string.
+ */
+int sprintk(char *str, int size, const char *fmt, ...);
+
+/**
+ * The alternate form of sprintk.
+ */
+int vsprintk(char *str, int size, const char *fmt, va_list args);
+
 #endif // PRINT_H
@@ -17,18 +17,29 @@
  */
 typedef volatile bool spinlock_t;
 
+/**
+ * Tells the CPU core that it is in a spin loop, where the ISA provides a way
+ * to do so.
+ */
+static inline void spin_pause(void)
+{
+#if defined(__ISA_X86__) || defined(__ISA_X86_64__)
+    __builtin_ia32_pause();
+#else
+    __asm__ __volatile__ ("" : : : "memory");
+#endif
+}
+
 /**
  * Spins until the mutex is unlocked.
  */
 static inline void spin_wait(spinlock_t *lock)
 {
-#if 0
     if (lock) {
         while (*lock) {
-            __builtin_ia32_pause();
+            spin_pause();
         }
     }
-#endif
 }
 
 /**
@@ -36,15 +47,13 @@ static inline void spin_wait(spinlock_t *lock)
  */
 static inline void spin_lock(spinlock_t *lock)
 {
-#if 0
     if (lock) {
         while (!__sync_bool_compare_and_swap(lock, false, true)) {
             do {
-                __builtin_ia32_pause();
+                spin_pause();
             } while (*lock);
         }
     }
-#endif
 }
 
 /**
@@ -52,7 +61,6 @@ static inline void spin_lock(spinlock_t *lock)
  */
 static inline void spin_unlock(spinlock_t *lock)
 {
-  return;
     if (lock) {
         __sync_synchronize();
         *lock = false;
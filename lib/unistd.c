@@ -1,19 +1,106 @@
 // SPDX-License-Identifier: GPL-2.0
 // Copyright (C) 2020-2022 Martin Whitaker.
+//
+// Where the CPU can be halted until the next interrupt, a sleep halts the
+// CPU with interrupts enabled, and rechecks the time each time it is woken
+// by a timer interrupt. This saves power, and avoids repeatedly reading the
+// timer, which is expensive under virtualisation. Until a timer interrupt has
+// been seen by the sleeping CPU, or where the CPU can't be halted, the timer
+// is polled instead, but with interrupts enabled so that a working timer
+// interrupt is detected. Interrupts may only be delivered to some CPUs, so
+// this is tracked separately for each CPU.
+//
+// When running as an OS process, a sleep blocks the process in the OS until
+// the time is up, so that the CPU core is free for the other processes.
 
 #include "common.h"
 
+#if defined(__ARCH_NATIVE)
+#include <time.h>
+#endif
+
 #include "cpuinfo.h"
 
+#include "config.h"
+
+#include "unistd.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#if defined(__ARCH_NATIVE)
+// Running as a user process, so the CPU can't be halted. The OS is asked to
+// sleep instead.
+#define CAN_HALT    0
+#elif defined(__ISA_X86__) || defined(__ISA_X86_64__) || defined(__ISA_RISCV32__) || defined(__ISA_RISCV64__)
+#define CAN_HALT    1
+#else
+#define CAN_HALT    0
+#endif
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static volatile bool        timer_seen[MAX_CPUS];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+#if defined(__ARCH_NATIVE)
+static void os_sleep(uint64_t usec)
+{
+    struct timespec time = { usec / 1000000, (usec % 1000000) * 1000 };
+    // This may return early if a signal is delivered.
+    nanosleep(&time, NULL);
+}
+#endif
+
+static inline void halt_until_interrupt(void)
+{
+#if defined(__ISA_X86__) || defined(__ISA_X86_64__)
+    __asm__ __volatile__ ("hlt");
+#elif defined(__ISA_RISCV32__) || defined(__ISA_RISCV64__)
+    __asm__ __volatile__ ("wfi");
+#endif
+}
+
 //------------------------------------------------------------------------------
 // Public Functions
 //------------------------------------------------------------------------------
 
+uint64_t get_time_us(void)
+{
+    return io_read(AM_TIMER_UPTIME).us;
+}
+
+void timer_interrupt(void)
+{
+    timer_seen[cpu_current()] = true;
+}
+
 void usleep(unsigned int usec)
 {
-    uint64_t now = io_read(AM_TIMER_UPTIME).us;
+    uint64_t now = get_time_us();
     uint64_t end = now + usec;
-    while (io_read(AM_TIMER_UPTIME).us < end);
+
+    bool irq_enabled = ienabled();
+    iset(true);
+#if defined(__ARCH_NATIVE)
+    while ((now = get_time_us()) < end) {
+        os_sleep(end - now);
+    }
+#else
+    int my_cpu = cpu_current();
+    while (get_time_us() < end) {
+        if (CAN_HALT && timer_seen[my_cpu]) {
+            halt_until_interrupt();
+        }
+    }
+#endif
+    iset(irq_enabled);
 }
 
 void sleep(unsigned int sec)
@@ -10,6 +10,19 @@
  * Copyright (C) 2020-2022 Martin Whitaker.
  */
 
+#include <stdint.h>
+
+/**
+ * Returns the time in microseconds since the program started.
+ */
+uint64_t get_time_us(void);
+
+/**
+ * Records a timer interrupt on the current CPU. Must be called by the interrupt
+ * handler on each timer interrupt, to allow the sleep functions to halt the CPU.
+ */
+void timer_interrupt(void);
+
 /**
  * Sleeps for at least usec microseconds.
  */
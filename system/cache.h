@@ -31,4 +31,43 @@ static inline void cache_flush(void)
 {
 }
 
+/**
+ * Set to 1 if cache_flush_line() is supported by the target CPU, else 0.
+ */
+#if defined(__x86_64__) || defined(__i386__) || defined(__riscv_zicbom)
+#define CACHE_FLUSH_LINE    1
+#else
+#define CACHE_FLUSH_LINE    0
+#endif
+
+/**
+ * Evict the cache line containing addr from all levels of the CPU caches,
+ * writing it back to memory if it has been modified. Does nothing if the CPU
+ * has no instruction to do this.
+ */
+static inline void cache_flush_line(const volatile void *addr)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("clflush %0" : : "m" (*(const volatile char *)addr) : "memory");
+#elif defined(__riscv_zicbom)
+    __asm__ __volatile__ ("cbo.flush (%0)" : : "r" (addr) : "memory");
+#else
+    (void)addr;
+#endif
+}
+
+/**
+ * Wait for all preceding memory accesses and cache line flushes to complete.
+ */
+static inline void cache_flush_wait(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("mfence" : : : "memory");
+#elif defined(__riscv)
+    __asm__ __volatile__ ("fence rw, rw" : : : "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
 #endif // CACHE_H
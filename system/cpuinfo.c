@@ -15,6 +15,20 @@
 
 #include "config.h"
 
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define PREFETCH_LINE_SIZE          64
+
+#define DEFAULT_PREFETCH_DISTANCE   512
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static const uintptr_t prefetch_distances[] = { 0, 128, 256, 512, 1024, 2048, 4096 };
+
 //------------------------------------------------------------------------------
 // Public Variables
 //------------------------------------------------------------------------------
@@ -28,6 +42,8 @@ uint32_t    l2_cache_speed  = 0;
 uint32_t    l3_cache_speed  = 0;
 uint32_t    ram_speed = 0;
 
+uintptr_t   prefetch_distance = DEFAULT_PREFETCH_DISTANCE;
+
 uint32_t    clks_per_msec = 0;
 
 //------------------------------------------------------------------------------
@@ -118,6 +134,57 @@ static void measure_memory_bandwidth(void)
     ram_speed = memspeed(bench_start_adr, mem_test_len, 25);
 }
 
+// Times a descending read, invert, and write sweep of the same form as the
+// top-down passes of the moving inversions tests.
+static uint64_t sweep_down_time(uintptr_t start, uint32_t len, uintptr_t distance)
+{
+    volatile uintptr_t *ps = (uintptr_t *)start;
+    volatile uintptr_t *p  = (uintptr_t *)(start + len) - 1;
+
+    uint64_t start_time = io_read(AM_TIMER_UPTIME).us;
+    do {
+        if (distance != 0 && ((uintptr_t)p & (PREFETCH_LINE_SIZE - 1)) == 0) {
+            __builtin_prefetch((const void *)((uintptr_t)p - distance), 1);
+        }
+        *p = ~*p;
+    } while (p-- > ps);
+    uint64_t end_time = io_read(AM_TIMER_UPTIME).us;
+
+    return end_time - start_time;
+}
+
+static void calibrate_prefetch_distance(void)
+{
+    uintptr_t bench_start_adr = (uintptr_t)heap.start;
+    size_t mem_test_len;
+
+    // Use a region too large to be held in the caches.
+    if (l3_cache) {
+        mem_test_len = 4*l3_cache*1024;
+    } else if (l2_cache) {
+        mem_test_len = 4*l2_cache*1024;
+    } else {
+        return; // If we're not able to detect L2, keep the default distance
+    }
+
+    // Take the best of two sweeps for each distance, to reduce the effect of
+    // any interruptions.
+    uint64_t best_time = UINT64_MAX;
+    for (size_t i = 0; i < sizeof(prefetch_distances) / sizeof(prefetch_distances[0]); i++) {
+        uint64_t time = UINT64_MAX;
+        for (int j = 0; j < 2; j++) {
+            uint64_t t = sweep_down_time(bench_start_adr, mem_test_len, prefetch_distances[i]);
+            if (t < time) {
+                time = t;
+            }
+        }
+        if (time < best_time) {
+            best_time = time;
+            prefetch_distance = prefetch_distances[i];
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 // Public Functions
 //------------------------------------------------------------------------------
@@ -126,5 +193,6 @@ void membw_init(void)
 {
     if(enable_bench) {
         measure_memory_bandwidth();
+        calibrate_prefetch_distance();
     }
 }
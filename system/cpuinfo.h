@@ -46,6 +46,13 @@ extern uint32_t l3_cache_speed;
  */
 extern uint32_t ram_speed;
 
+/**
+ * The distance in bytes ahead of the current address at which the descending
+ * test sweeps issue software prefetches. Zero if software prefetching gives
+ * no benefit.
+ */
+extern uintptr_t prefetch_distance;
+
 /**
  * The TSC clock speed in kHz. Assumed to be the nominal CPU clock speed.
  */
@@ -57,7 +64,8 @@ extern uint32_t clks_per_msec;
 void cpuinfo_init(void);
 
 /**
- * Determines the RAM & caches bandwidth and stores it in the exported variables.
+ * Determines the RAM & caches bandwidth and the best prefetch distance, and
+ * stores them in the exported variables.
  */
 void membw_init(void);
 
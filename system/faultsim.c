@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0
+// Implements a simulated faulty memory model. One fault of each kind is
+// placed in the physical memory map, and every test word access that falls
+// in the range covered by the faults is checked against each fault:
+//
+//  - stuck-at: the bit always reads as 0 (or 1)
+//  - transition: the bit cannot change from 0 to 1 (or from 1 to 0)
+//  - coupling: a transition of the bit in the aggressor word inverts the
+//    same bit in the victim word
+//  - address decoder: accesses to one word are decoded to another
+//  - retention: the bit fades to 0 if not rewritten within the retention time
+//
+// The time and the number of bytes accessed between the start of a test and
+// the first error reported at an address affected by a fault are recorded,
+// so that the effect of changes to the tests on fault coverage and detection
+// latency can be measured. A test that accesses memory other than through the
+// memory access functions (e.g. with atomic operations) records that it has
+// bypassed the model, and is reported as not simulated.
+
+#ifdef FAULT_SIM
+
+#include "common.h"
+#include "unistd.h"
+
+#include "memsize.h"
+#include "pmem.h"
+#include "screen.h"
+#include "vmem.h"
+
+#include "print.h"
+
+#include "faultsim.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MAX_SIM_TESTS       32
+
+#define RETENTION_TIME_US   1000000
+
+#define NOT_DETECTED        UINT64_MAX
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef enum {
+    FAULT_STUCK_AT_0,
+    FAULT_STUCK_AT_1,
+    FAULT_TRANSITION_UP,
+    FAULT_TRANSITION_DOWN,
+    FAULT_COUPLING,
+    FAULT_ADDRESS_DECODER,
+    FAULT_RETENTION,
+    NUM_FAULT_TYPES
+} fault_type_t;
+
+typedef struct {
+    uintptr_t       addr;           // the faulty (or aggressor) word
+    uintptr_t       other;          // the victim or aliased word
+    uint64_t        mask;           // the faulty bit
+    uint64_t        last_write;     // time of the last write, for retention
+} fault_t;
+
+typedef struct {
+    uint64_t        time_us;
+    uint64_t        bytes;
+} detection_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static const char *fault_names[NUM_FAULT_TYPES] = {
+    "stuck-at-0",
+    "stuck-at-1",
+    "transition-up",
+    "transition-down",
+    "coupling",
+    "address-decoder",
+    "retention"
+};
+
+static fault_t      faults[NUM_FAULT_TYPES];
+
+static int          current_test = -1;
+static uint64_t     test_start_time  = 0;
+static uint64_t     test_start_bytes = 0;
+
+static detection_t  detections[MAX_SIM_TESTS][NUM_FAULT_TYPES];
+
+static bool         bypassed[MAX_SIM_TESTS];
+
+//------------------------------------------------------------------------------
+// Public Variables
+//------------------------------------------------------------------------------
+
+uintptr_t   faultsim_lo = UINTPTR_MAX;
+uintptr_t   faultsim_hi = 0;
+
+uint64_t    faultsim_bytes = 0;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static uint64_t raw_read(uintptr_t addr, int size)
+{
+    if (size == 8) {
+        return *(volatile uint64_t *)addr;
+    }
+    return *(volatile uint32_t *)addr;
+}
+
+static void raw_write(uintptr_t addr, uint64_t value, int size)
+{
+    if (size == 8) {
+        *(volatile uint64_t *)addr = value;
+    } else {
+        *(volatile uint32_t *)addr = value;
+    }
+}
+
+// Returns the page at the given index into the physical memory map, or 0 if
+// there is no such page.
+static uintptr_t nth_page(uintptr_t n)
+{
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t size = pm_map[i].end - pm_map[i].start;
+        if (n < size) {
+            return pm_map[i].start + n;
+        }
+        n -= size;
+    }
+    return 0;
+}
+
+static void extend_range(uintptr_t addr)
+{
+    if (addr < faultsim_lo) {
+        faultsim_lo = addr;
+    }
+    if (addr + sizeof(uint64_t) - 1 > faultsim_hi) {
+        faultsim_hi = addr + sizeof(uint64_t) - 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void faultsim_init(void)
+{
+    faultsim_lo = UINTPTR_MAX;
+    faultsim_hi = 0;
+
+    // Leave room for the victim and aliased words in the following pages.
+    uintptr_t num_pages = (num_pm_pages > 3) ? num_pm_pages - 3 : 0;
+    for (int i = 0; i < NUM_FAULT_TYPES; i++) {
+        fault_t *fault = &faults[i];
+        uintptr_t page = nth_page(num_pages * (i + 1) / (NUM_FAULT_TYPES + 1));
+        if (page == 0) {
+            fault->addr  = 0;
+            fault->other = 0;
+            continue;
+        }
+        uintptr_t offset = (i * 0x2c8) & (PAGE_SIZE - sizeof(uint64_t));
+        fault->addr  = (uintptr_t)first_word_mapping(page) + offset;
+        fault->other = (uintptr_t)first_word_mapping(page + 2) + offset;
+        fault->mask  = (uint64_t)1 << ((i * 7 + 3) % 32);
+        fault->last_write = get_time_us();
+        extend_range(fault->addr);
+        if (i == FAULT_COUPLING || i == FAULT_ADDRESS_DECODER) {
+            extend_range(fault->other);
+        }
+    }
+
+    faultsim_reset();
+}
+
+uint64_t faultsim_read(uintptr_t addr, int size)
+{
+    if (addr == faults[FAULT_ADDRESS_DECODER].addr) {
+        addr = faults[FAULT_ADDRESS_DECODER].other;
+    }
+    uint64_t value = raw_read(addr, size);
+    for (int i = 0; i < NUM_FAULT_TYPES; i++) {
+        const fault_t *fault = &faults[i];
+        if (fault->addr != addr) {
+            continue;
+        }
+        switch (i) {
+          case FAULT_STUCK_AT_0:
+            value &= ~fault->mask;
+            break;
+          case FAULT_STUCK_AT_1:
+            value |= fault->mask;
+            break;
+          case FAULT_RETENTION:
+            if (get_time_us() - fault->last_write > RETENTION_TIME_US) {
+                value &= ~fault->mask;
+                raw_write(addr, value, size);
+            }
+            break;
+          default:
+            break;
+        }
+    }
+    return value;
+}
+
+void faultsim_write(uintptr_t addr, uint64_t value, int size)
+{
+    if (addr == faults[FAULT_ADDRESS_DECODER].addr) {
+        addr = faults[FAULT_ADDRESS_DECODER].other;
+    }
+    uint64_t old_value = raw_read(addr, size);
+    for (int i = 0; i < NUM_FAULT_TYPES; i++) {
+        fault_t *fault = &faults[i];
+        if (fault->addr != addr) {
+            continue;
+        }
+        switch (i) {
+          case FAULT_TRANSITION_UP:
+            if (!(old_value & fault->mask)) {
+                value &= ~fault->mask;
+            }
+            break;
+          case FAULT_TRANSITION_DOWN:
+            if (old_value & fault->mask) {
+                value |= fault->mask;
+            }
+            break;
+          case FAULT_COUPLING:
+            if ((old_value ^ value) & fault->mask) {
+                raw_write(fault->other, raw_read(fault->other, size) ^ fault->mask, size);
+            }
+            break;
+          case FAULT_RETENTION:
+            fault->last_write = get_time_us();
+            break;
+          default:
+            break;
+        }
+    }
+    raw_write(addr, value, size);
+}
+
+void faultsim_reset(void)
+{
+    for (int i = 0; i < MAX_SIM_TESTS; i++) {
+        for (int j = 0; j < NUM_FAULT_TYPES; j++) {
+            detections[i][j].time_us = NOT_DETECTED;
+            detections[i][j].bytes   = 0;
+        }
+        bypassed[i] = false;
+    }
+    current_test = -1;
+}
+
+void faultsim_test_start(int test)
+{
+    current_test = (test < MAX_SIM_TESTS) ? test : -1;
+    test_start_time  = get_time_us();
+    test_start_bytes = faultsim_bytes;
+}
+
+void faultsim_bypass(void)
+{
+    if (current_test >= 0) {
+        bypassed[current_test] = true;
+    }
+}
+
+void faultsim_error(uintptr_t addr)
+{
+    if (current_test < 0) {
+        return;
+    }
+    addr &= ~(uintptr_t)(sizeof(uint64_t) - 1);
+    for (int i = 0; i < NUM_FAULT_TYPES; i++) {
+        const fault_t *fault = &faults[i];
+        bool affected = false;
+        switch (i) {
+          case FAULT_COUPLING:
+            affected = (addr == fault->other);
+            break;
+          case FAULT_ADDRESS_DECODER:
+            affected = (addr == fault->addr || addr == fault->other);
+            break;
+          default:
+            affected = (addr == fault->addr);
+            break;
+        }
+        detection_t *detection = &detections[current_test][i];
+        if (fault->addr != 0 && affected && detection->time_us == NOT_DETECTED) {
+            detection->time_us = get_time_us() - test_start_time;
+            detection->bytes   = faultsim_bytes - test_start_bytes;
+        }
+    }
+}
+
+void faultsim_report(int num_tests)
+{
+    if (num_tests > MAX_SIM_TESTS) {
+        num_tests = MAX_SIM_TESTS;
+    }
+    printf("\033[%d;1H\n", SCREEN_HEIGHT + 1);
+    for (int i = 0; i < num_tests; i++) {
+        if (bypassed[i]) {
+            printf("faultsim test %i not simulated\n", i);
+            continue;
+        }
+        for (int j = 0; j < NUM_FAULT_TYPES; j++) {
+            const detection_t *detection = &detections[i][j];
+            char line[80];
+            if (detection->time_us == NOT_DETECTED) {
+                sprintk(line, sizeof(line), "faultsim test %i %s missed", i, fault_names[j]);
+            } else {
+                sprintk(line, sizeof(line), "faultsim test %i %s %uus %uB", i, fault_names[j],
+                        (uintptr_t)detection->time_us, (uintptr_t)detection->bytes);
+            }
+            printf("%s\n", line);
+        }
+    }
+}
+
+#endif // FAULT_SIM
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef FAULTSIM_H
+#define FAULTSIM_H
+/**
+ * \file
+ *
+ * Provides a simulated faulty memory model, used to measure how quickly each
+ * test detects each kind of memory fault. Only present when built with
+ * FAULT_SIM defined, in which case the memory access functions in memrw32.h
+ * and memrw64.h pass every access in the range containing the simulated
+ * faults through this model.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The lowest and highest addresses affected by a simulated fault.
+ */
+extern uintptr_t faultsim_lo;
+extern uintptr_t faultsim_hi;
+
+/**
+ * The total number of bytes accessed through the memory access functions.
+ */
+extern uint64_t faultsim_bytes;
+
+/**
+ * Places one fault of each kind at fixed points spread across the physical
+ * memory map. Must be called after the memory map has been finalised.
+ */
+void faultsim_init(void);
+
+/**
+ * Reads and returns the value of the specified size stored at addr, as seen
+ * through the faulty memory model.
+ */
+uint64_t faultsim_read(uintptr_t addr, int size);
+
+/**
+ * Writes the value of the specified size to addr, as seen through the faulty
+ * memory model.
+ */
+void faultsim_write(uintptr_t addr, uint64_t value, int size);
+
+/**
+ * Clears the detection records. Called at the start of each run.
+ */
+void faultsim_reset(void);
+
+/**
+ * Records the start time and the byte count for the specified test.
+ */
+void faultsim_test_start(int test);
+
+/**
+ * Records that the current test accesses memory without passing through the
+ * faulty memory model, so its results are reported as not simulated.
+ */
+void faultsim_bypass(void);
+
+/**
+ * Records the detection of any simulated fault that affects addr by the
+ * current test, if that fault has not already been detected by that test.
+ */
+void faultsim_error(uintptr_t addr);
+
+/**
+ * Writes the detection latency of each fault for each of the first num_tests
+ * tests to the console stream.
+ */
+void faultsim_report(int num_tests);
+
+/**
+ * Returns true if addr lies in the range containing the simulated faults.
+ */
+static inline bool faultsim_in_range(uintptr_t addr)
+{
+    return addr >= faultsim_lo && addr <= faultsim_hi;
+}
+
+#endif // FAULTSIM_H
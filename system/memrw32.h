@@ -14,12 +14,22 @@
 
 #include <stdint.h>
 
+#ifdef FAULT_SIM
+#include "faultsim.h"
+#endif
+
 /**
  * Reads and returns the value stored in the 32-bit memory location pointed
  * to by ptr.
  */
 static inline uint32_t read32(const volatile uint32_t *ptr)
 {
+#ifdef FAULT_SIM
+  faultsim_bytes += sizeof(*ptr);
+  if (faultsim_in_range((uintptr_t)ptr)) {
+    return faultsim_read((uintptr_t)ptr, sizeof(*ptr));
+  }
+#endif
   return *ptr;
 }
 
@@ -28,6 +38,13 @@ static inline uint32_t read32(const volatile uint32_t *ptr)
  */
 static inline void write32(volatile uint32_t *ptr, uint32_t val)
 {
+#ifdef FAULT_SIM
+  faultsim_bytes += sizeof(*ptr);
+  if (faultsim_in_range((uintptr_t)ptr)) {
+    faultsim_write((uintptr_t)ptr, val, sizeof(*ptr));
+    return;
+  }
+#endif
   *ptr = val;
 }
 
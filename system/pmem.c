@@ -10,8 +10,24 @@
 
 #include "common.h"
 
+#if defined(__ARCH_NATIVE)
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+#endif
+
+#include "config.h"
 #include "memsize.h"
 #include "pmem.h"
+#include "vmem.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#if defined(__ARCH_NATIVE)
+#define OS_MEM_ALIGN    SIZE_C(2,MB)    // the usual huge page size
+#endif
 
 //------------------------------------------------------------------------------
 // Public Variables
@@ -22,18 +38,100 @@ pm_map_t    pm_map[MAX_MEM_SEGMENTS];
 int         pm_map_size = 0;
 size_t      num_pm_pages = 0;
 
+#if defined(__ARCH_NATIVE)
+intptr_t    os_mem_offset = 0;
+
+uint64_t    os_mem_huge_size = 0;
+bool        os_mem_locked    = false;
+#endif
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+#if defined(__ARCH_NATIVE)
+static uintptr_t    os_mem_pages = 0;
+#endif
+
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
 
 static void init_pm_map()
 {
+#if defined(__ARCH_NATIVE)
+    if (os_mem_pages > 0) {
+        // Number the pages as if they were physical memory starting at the
+        // second window, so that none of them fall in the low window.
+        pm_map[0].start = VM_WINDOW_SIZE;
+        pm_map[0].end   = VM_WINDOW_SIZE + os_mem_pages;
+        pm_map_size++;
+        num_pm_pages = os_mem_pages;
+        return;
+    }
+#endif
     pm_map[0].start = (uintptr_t)heap.start >> PAGE_SHIFT;
     pm_map[0].end = (uintptr_t)heap.end >> PAGE_SHIFT;
     pm_map_size ++;
     num_pm_pages = pm_map[0].end - pm_map[0].start;
 }
 
+#if defined(__ARCH_NATIVE)
+// Returns true if transparent huge pages may be used for shared anonymous
+// memory. This is backed by shmem, so is controlled by shmem_enabled rather
+// than by the usual THP setting, and the kernel default for it is "never".
+static bool shmem_thp_enabled(void)
+{
+    FILE *file = fopen("/sys/kernel/mm/transparent_hugepage/shmem_enabled", "r");
+    if (file == NULL) {
+        return false;
+    }
+    char line[128];
+    bool enabled = false;
+    if (fgets(line, sizeof(line), file) != NULL) {
+        // The current setting is the one in brackets.
+        for (char *p = line; *p != '\0'; p++) {
+            if (*p == '[') {
+                enabled = strncmp(p, "[always]", 8) == 0
+                       || strncmp(p, "[within_size]", 13) == 0
+                       || strncmp(p, "[advise]", 8) == 0
+                       || strncmp(p, "[force]", 7) == 0;
+                break;
+            }
+        }
+    }
+    fclose(file);
+    return enabled;
+}
+
+// Returns the amount of the shared mapping at base that is currently mapped
+// with huge pages, as reported by the kernel in /proc/self/smaps.
+static uint64_t shmem_huge_size(const uint8_t *base)
+{
+    FILE *file = fopen("/proc/self/smaps", "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char line[256];
+    bool in_mapping = false;
+    uint64_t huge_kb = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            in_mapping = (start == (uintptr_t)base);
+        } else if (in_mapping) {
+            unsigned long kb;
+            if (sscanf(line, "ShmemPmdMapped: %lu kB", &kb) == 1) {
+                huge_kb = kb;
+                break;
+            }
+        }
+    }
+    fclose(file);
+    return huge_kb * 1024;
+}
+#endif
+
 static void sort_pm_map(void)
 {
     // Do an insertion sort on the pm_map. On an already sorted list this should be a O(n) algorithm.
@@ -52,6 +150,65 @@ static void sort_pm_map(void)
 // Public Functions
 //------------------------------------------------------------------------------
 
+#if defined(__ARCH_NATIVE)
+void pmem_os_alloc(void)
+{
+    uint64_t size = os_mem_size;
+    if (size == 0) {
+        struct sysinfo info;
+        if (sysinfo(&info) != 0) {
+            return;
+        }
+        size = (uint64_t)info.freeram * info.mem_unit / 100 * os_mem_percent;
+    }
+    size &= ~(uint64_t)(OS_MEM_ALIGN - 1);
+    if (size == 0) {
+        return;
+    }
+
+    // The memory must be shared, so that the processes that run the other
+    // CPUs see the same memory after they are forked.
+    uint8_t *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    bool transparent = false;
+    if (base != MAP_FAILED) {
+        os_mem_huge_size = size;
+    } else {
+        // There are not enough huge pages reserved, so ask for transparent
+        // huge pages instead. These must be aligned on a huge page boundary,
+        // so allocate an extra huge page and trim the ends. Whether any are
+        // used depends on the shmem THP setting and on the memory available.
+        base = mmap(NULL, size + OS_MEM_ALIGN, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return;
+        }
+        uint8_t *aligned = (uint8_t *)(((uintptr_t)base + OS_MEM_ALIGN - 1) & ~(uintptr_t)(OS_MEM_ALIGN - 1));
+        if (aligned > base) {
+            munmap(base, aligned - base);
+        }
+        munmap(aligned + size, (base + OS_MEM_ALIGN) - aligned);
+        base = aligned;
+        transparent = shmem_thp_enabled();
+        if (transparent) {
+            madvise(base, size, MADV_HUGEPAGE);
+        }
+    }
+
+    // Lock the memory, so that it stays resident in the same physical pages
+    // for the whole run. This needs CAP_IPC_LOCK or a large RLIMIT_MEMLOCK.
+    os_mem_locked = (mlock(base, size) == 0);
+
+    // Locking faults the pages in, so the kernel can now tell us how much of
+    // the memory it actually placed in transparent huge pages. If it wasn't
+    // locked, this isn't known until the pages have been used.
+    if (transparent && os_mem_locked) {
+        os_mem_huge_size = shmem_huge_size(base);
+    }
+
+    os_mem_offset = (intptr_t)base - (intptr_t)((uintptr_t)VM_WINDOW_SIZE << PAGE_SHIFT);
+    os_mem_pages  = size >> PAGE_SHIFT;
+}
+#endif
+
 void pmem_init(void)
 {
     init_pm_map();
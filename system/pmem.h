@@ -10,6 +10,7 @@
  * Copyright (C) 2020-2022 Martin Whitaker.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -25,6 +26,35 @@ extern int          pm_map_size;
 
 extern size_t       num_pm_pages;
 
+#if defined(__ARCH_NATIVE)
+/**
+ * When running as an OS process, the difference between the virtual address
+ * of the memory under test and the address we report for it.
+ */
+extern intptr_t     os_mem_offset;
+
+/**
+ * When running as an OS process, the amount of the memory under test that is
+ * known to be in huge pages. This is the whole of the memory if reserved huge
+ * pages were available, otherwise the amount placed in transparent huge pages
+ * when the memory was locked, or 0 if none were used or it is not known.
+ */
+extern uint64_t     os_mem_huge_size;
+
+/**
+ * When running as an OS process, true if the memory under test is locked.
+ */
+extern bool         os_mem_locked;
+
+/**
+ * Allocates the memory to be tested from the OS, backed by huge pages where
+ * possible, and locks it in place. The amount is set by the "osmem" option.
+ * Must be called before the other CPUs are started, so that they all share
+ * the mapping. If the allocation fails, the AM heap is tested instead.
+ */
+void pmem_os_alloc(void);
+#endif
+
 void pmem_init(void);
 
 #endif /* PMEM_H */
@@ -13,18 +13,45 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "pmem.h"
 #include "vmem.h"
 
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
 
+#if !defined(__ARCH_NATIVE)
 static uintptr_t    mapped_window = 2;
+#endif
 
 //------------------------------------------------------------------------------
 // Public Functions
 //------------------------------------------------------------------------------
 
+#if defined(__ARCH_NATIVE)
+
+// Running as an OS process, all the memory under test is permanently mapped,
+// at a fixed offset from the address we report for it (see pmem.c).
+
+bool map_window(uintptr_t start_page)
+{
+    (void)start_page;
+
+    return true;
+}
+
+void *first_word_mapping(uintptr_t page)
+{
+    return (void *)((page << PAGE_SHIFT) + os_mem_offset);
+}
+
+uintptr_t page_of(void *addr)
+{
+    return ((uintptr_t)addr - os_mem_offset) >> PAGE_SHIFT;
+}
+
+#else
+
 bool map_window(uintptr_t start_page)
 {
     uintptr_t window = start_page >> (30 - PAGE_SHIFT);
@@ -52,11 +79,6 @@ void *first_word_mapping(uintptr_t page)
     return result;
 }
 
-void *last_word_mapping(uintptr_t page, size_t word_size)
-{
-    return (uint8_t *)first_word_mapping(page) + (PAGE_SIZE - word_size);
-}
-
 uintptr_t page_of(void *addr)
 {
     uintptr_t page = (uintptr_t)addr >> PAGE_SHIFT;
@@ -66,3 +88,10 @@ uintptr_t page_of(void *addr)
     }
     return page;
 }
+
+#endif
+
+void *last_word_mapping(uintptr_t page, size_t word_size)
+{
+    return (uint8_t *)first_word_mapping(page) + (PAGE_SIZE - word_size);
+}
@@ -30,7 +30,9 @@ int test_addr_walk1(int my_cpu)
     int ticks = 0;
 
     // There isn't a meaningful address for this test.
-    test_addr[my_cpu] = 0;
+    if (my_cpu >= 0) {
+        test_addr[my_cpu] = 0;
+    }
 
     testword_t invert = 0;
     for (int i = 0; i < 2; i++) {
@@ -42,7 +44,9 @@ int test_addr_walk1(int my_cpu)
             continue;
         }
 
-        for (int j = 0; j < vm_map_size; j++) {
+        // The walks within a segment overlap, so each CPU takes whole segments.
+        int first_segment = (num_active_cpus > 1) ? chunk_index[my_cpu] : 0;
+        for (int j = first_segment; j < vm_map_size; j += num_active_cpus) {
             uintptr_t pb = (uintptr_t)vm_map[j].start;
             uintptr_t pe = (uintptr_t)vm_map[j].end;
 
@@ -55,7 +59,7 @@ int test_addr_walk1(int my_cpu)
                     break;
                 }
                 testword_t expect = invert ^ (testword_t)p1;
-                write_word(p1, expect);
+                write_word_uncached(p1, expect);
 
                 // Walking one on our second address.
                 uintptr_t mask2 = sizeof(testword_t);
@@ -68,12 +72,12 @@ int test_addr_walk1(int my_cpu)
                     if (p2 > (testword_t *)pe) {
                         break;
                     }
-                    write_word(p2, ~invert ^ (testword_t)p2);
+                    write_word_uncached(p2, ~invert ^ (testword_t)p2);
 
-                    testword_t actual = read_word(p1);
+                    testword_t actual = read_word_uncached(p1);
                     if (unlikely(actual != expect)) {
                         addr_error(p1, p2, expect, actual);
-                        write_word(p1, expect);  // recover from error
+                        write_word_uncached(p1, expect);  // recover from error
                     }
                 } while (mask2);
 
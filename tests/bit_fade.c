@@ -37,8 +37,9 @@ static int pattern_fill(int my_cpu, testword_t pattern)
     }
 
     for (int i = 0; i < vm_map_size; i++) {
-        testword_t *start = vm_map[i].start;
-        testword_t *end   = vm_map[i].end;
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, sizeof(testword_t));
+        if (end < start) SKIP_RANGE(1)  // we need at least one word for this test
 
         testword_t *p  = start;
         testword_t *pe = start;
@@ -75,8 +76,9 @@ static int pattern_check(int my_cpu, testword_t pattern)
     int ticks = 0;
 
     for (int i = 0; i < vm_map_size; i++) {
-        testword_t *start = vm_map[i].start;
-        testword_t *end   = vm_map[i].end;
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, sizeof(testword_t));
+        if (end < start) SKIP_RANGE(1)  // we need at least one word for this test
 
         testword_t *p  = start;
         testword_t *pe = start;
@@ -139,7 +141,11 @@ int test_bit_fade(int my_cpu, int stage, int sleep_secs)
     const testword_t all_zero = 0;
     const testword_t all_ones = ~all_zero;
 
-    static int last_stage = -1;
+    // Each CPU keeps its own record, as they run in parallel. Only the delay
+    // stages are compared, so the initial value of 0 means no stage.
+    static int last_stage[MAX_CPUS];
+
+    int cpu = (my_cpu < 0) ? 0 : my_cpu;
 
     int ticks = 0;
 
@@ -149,7 +155,7 @@ int test_bit_fade(int my_cpu, int stage, int sleep_secs)
         break;
       case 1:
         // Only sleep once.
-        if (stage != last_stage) {
+        if (stage != last_stage[cpu]) {
             ticks = fade_delay(my_cpu, sleep_secs);
         }
         break;
@@ -161,7 +167,7 @@ int test_bit_fade(int my_cpu, int stage, int sleep_secs)
         break;
       case 4:
         // Only sleep once.
-        if (stage != last_stage) {
+        if (stage != last_stage[cpu]) {
             ticks = fade_delay(my_cpu, sleep_secs);
         }
         break;
@@ -171,7 +177,7 @@ int test_bit_fade(int my_cpu, int stage, int sleep_secs)
       default:
         break;
     }
-    last_stage = stage;
+    last_stage[cpu] = stage;
 
     return ticks;
 }
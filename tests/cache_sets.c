@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0
+// Tests the cache memory rather than the main memory. Each CPU repeatedly
+// runs moving inversions and a random number sequence over its own small
+// working set, sized to fit in the L1, L2, or L3 cache (one cache level per
+// stage). Because the working set stays resident in the cache, the patterns
+// are written and read at cache bandwidth, so many passes over the working
+// set can be made in the time taken for one pass over main memory.
+
+#include "common.h"
+
+#include "cpuinfo.h"
+
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#include "test_funcs.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define WORDS_PER_TICK      (1 << 24)   // number of word accesses between ticks
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+// Returns the size of the working set for each CPU at the specified stage.
+// This is half the cache size, to leave room for the program code and data
+// and to allow for limited associativity. The L3 cache is shared between
+// all the CPUs.
+static uintptr_t working_set_size(int stage)
+{
+    uintptr_t size = 0;
+    switch (stage) {
+      case 0:
+        size = (uintptr_t)l1_cache * 1024;
+        break;
+      case 1:
+        size = (uintptr_t)l2_cache * 1024;
+        break;
+      case 2:
+        size = (uintptr_t)l3_cache * 1024 / num_active_cpus;
+        break;
+      default:
+        break;
+    }
+    return round_down(size / 2, CACHE_LINE_SIZE);
+}
+
+// Finds the first segment that can hold the working set for my_cpu, and
+// returns the start of the working set, or NULL if there isn't one.
+static testword_t *find_working_set(int my_cpu, uintptr_t size)
+{
+    for (int i = 0; i < vm_map_size; i++) {
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, CACHE_LINE_SIZE);
+        if (end >= start && (uintptr_t)(end - start + 1) * sizeof(testword_t) >= size) {
+            return start;
+        }
+    }
+    return NULL;
+}
+
+static void mov_inv(testword_t *start, testword_t *end, testword_t pattern1, testword_t pattern2)
+{
+    testword_t *p = start;
+    do {
+        write_word(p, pattern1);
+    } while (p++ < end);
+
+    p = start;
+    do {
+        testword_t actual = read_word(p);
+        if (unlikely(actual != pattern1)) {
+            data_error(p, pattern1, actual, true);
+        }
+        write_word(p, pattern2);
+    } while (p++ < end);
+
+    p = end;
+    do {
+        testword_t actual = read_word(p);
+        if (unlikely(actual != pattern2)) {
+            data_error(p, pattern2, actual, true);
+        }
+        write_word(p, pattern1);
+    } while (p-- > start);
+}
+
+static void random_seq(testword_t *start, testword_t *end, testword_t seed)
+{
+    testword_t prsg_state = seed;
+    testword_t *p = start;
+    do {
+        prsg_state = prsg(prsg_state);
+        write_word(p, prsg_state);
+    } while (p++ < end);
+
+    prsg_state = seed;
+    p = start;
+    do {
+        prsg_state = prsg(prsg_state);
+        testword_t expect = prsg_state;
+        testword_t actual = read_word(p);
+        if (unlikely(actual != expect)) {
+            data_error(p, expect, actual, true);
+        }
+        write_word(p, ~expect);
+    } while (p++ < end);
+
+    prsg_state = seed;
+    p = start;
+    do {
+        prsg_state = prsg(prsg_state);
+        testword_t expect = ~prsg_state;
+        testword_t actual = read_word(p);
+        if (unlikely(actual != expect)) {
+            data_error(p, expect, actual, true);
+        }
+    } while (p++ < end);
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+int test_cache_sets(int my_cpu, int stage, int iterations)
+{
+    int ticks = 0;
+
+    uintptr_t size = working_set_size(stage);
+
+    if (my_cpu == master_cpu) {
+        display_test_stage_description("L%i cache, %iKB per CPU", stage + 1, (int)(size / 1024));
+    }
+
+    testword_t *start = NULL;
+    testword_t *end   = NULL;
+    int repeats = 0;
+    if (my_cpu >= 0 && size > 0) {
+        start = find_working_set(my_cpu, size);
+    }
+    if (start != NULL) {
+        end = start + size / sizeof(testword_t) - 1;
+        // Each repeat makes seven accesses to each word.
+        repeats = WORDS_PER_TICK / (7 * (size / sizeof(testword_t)));
+        if (repeats < 1) {
+            repeats = 1;
+        }
+    }
+
+    testword_t prsg_state = io_read(AM_TIMER_UPTIME).us;
+    prsg_state *= 0x12345678;
+    prsg_state += my_cpu + 1;
+
+    for (int i = 0; i < iterations; i++) {
+        ticks++;
+        if (my_cpu < 0) {
+            continue;
+        }
+        if (start != NULL) {
+            test_addr[my_cpu] = (uintptr_t)start;
+            for (int j = 0; j < repeats; j++) {
+                prsg_state = prsg(prsg_state);
+                mov_inv(start, end, prsg_state, ~prsg_state);
+                random_seq(start, end, prsg_state);
+                BAILOUT;
+            }
+        }
+        do_tick(my_cpu);
+        BAILOUT;
+    }
+
+    return ticks;
+}
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0
+// Tests the cache coherency mechanisms by making all the active CPUs access
+// the same small set of cache lines. In the first phase, each CPU makes a
+// fixed number of atomic increments to a counter in each line, after which
+// the counters are checked for lost updates. In the second phase, a token is
+// passed from CPU to CPU, the owner of the token checking the payload word
+// written by the previous owner and writing a new one before passing the
+// token on, so each handoff moves the line between CPUs.
+//
+// The number of coherent transfers per second is displayed, which provides a
+// rough measure of the coherency throughput.
+//
+// The shared lines are accessed directly and with atomic operations, so this
+// test bypasses the simulated faulty memory model when built with FAULT_SIM.
+
+#include "common.h"
+#include "unistd.h"
+
+#include "barrier.h"
+
+#include "config.h"
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#ifdef FAULT_SIM
+#include "faultsim.h"
+#endif
+
+#include "test_funcs.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define NUM_SHARED_LINES    16
+
+#define LINE_WORDS          (CACHE_LINE_SIZE / sizeof(testword_t))
+
+#define INCREMENTS_PER_TICK (1 << 20)   // per CPU, a multiple of NUM_SHARED_LINES
+#define HANDOFFS_PER_TICK   (1 << 14)   // per CPU
+
+#define HANDOFF_TIMEOUT_US  1000000
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void sync_cpus(void)
+{
+    if (power_save < POWER_SAVE_HIGH) {
+        barrier_spin_wait(run_barrier);
+    } else {
+        barrier_halt_wait(run_barrier);
+    }
+}
+
+static testword_t handoff_pattern(testword_t token)
+{
+    return ~(token * 0x9e3779b9);
+}
+
+static void init_lines(volatile testword_t *lines)
+{
+    for (int i = 0; i < NUM_SHARED_LINES; i++) {
+        lines[i * LINE_WORDS] = 0;
+    }
+    volatile testword_t *token = &lines[NUM_SHARED_LINES * LINE_WORDS];
+    token[0] = 0;
+    token[1] = handoff_pattern(0);
+    __sync_synchronize();
+}
+
+static void increment_counters(volatile testword_t *lines, int cpu_index)
+{
+    for (int i = 0; i < INCREMENTS_PER_TICK; i++) {
+        int line = (i + cpu_index) % NUM_SHARED_LINES;
+        __sync_fetch_and_add(&lines[line * LINE_WORDS], 1);
+    }
+}
+
+static void check_counters(volatile testword_t *lines, int num_cpus)
+{
+    testword_t expect = (testword_t)num_cpus * (INCREMENTS_PER_TICK / NUM_SHARED_LINES);
+    for (int i = 0; i < NUM_SHARED_LINES; i++) {
+        testword_t *p = (testword_t *)&lines[i * LINE_WORDS];
+        testword_t actual = *p;
+        if (unlikely(actual != expect)) {
+            data_error(p, expect, actual, false);
+        }
+    }
+}
+
+static void pass_token(volatile testword_t *lines, int cpu_index, int num_cpus)
+{
+    volatile testword_t *token = &lines[NUM_SHARED_LINES * LINE_WORDS];
+    for (int i = 0; i < HANDOFFS_PER_TICK; i++) {
+        testword_t my_turn = (testword_t)i * num_cpus + cpu_index;
+
+        // Wait for the token, but don't wait forever if it has been lost.
+        uint64_t deadline = 0;
+        int spins = 0;
+        while (token[0] != my_turn) {
+            if (++spins % 0x10000 == 0) {
+                uint64_t now = get_time_us();
+                if (deadline == 0) {
+                    deadline = now + HANDOFF_TIMEOUT_US;
+                } else if (now > deadline) {
+                    data_error((testword_t *)token, my_turn, token[0], false);
+                    return;
+                }
+            }
+        }
+
+        testword_t expect = handoff_pattern(my_turn);
+        testword_t actual = token[1];
+        if (unlikely(actual != expect)) {
+            data_error((testword_t *)&token[1], expect, actual, false);
+        }
+        token[1] = handoff_pattern(my_turn + 1);
+        __sync_synchronize();
+        token[0] = my_turn + 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+int test_coherency(int my_cpu, int iterations)
+{
+    int ticks = 0;
+
+    // The shared lines are taken from the start of the first segment, which
+    // is the same for all CPUs.
+    volatile testword_t *lines = NULL;
+    if (vm_map_size > 0 && (size_t)(vm_map[0].end - vm_map[0].start) > (NUM_SHARED_LINES + 2) * LINE_WORDS) {
+        lines = (testword_t *)round_up((uintptr_t)vm_map[0].start, CACHE_LINE_SIZE);
+    }
+
+    int num_cpus  = num_active_cpus;
+    int cpu_index = (my_cpu >= 0 && num_cpus > 1) ? chunk_index[my_cpu] : 0;
+
+    for (int i = 0; i < iterations; i++) {
+        ticks++;
+        if (my_cpu < 0) {
+            continue;
+        }
+        if (lines != NULL) {
+            test_addr[my_cpu] = (uintptr_t)lines;
+
+            if (my_cpu == master_cpu) {
+#ifdef FAULT_SIM
+                faultsim_bypass();
+#endif
+                init_lines(lines);
+            }
+            sync_cpus();
+            uint64_t start_time = get_time_us();
+
+            increment_counters(lines, cpu_index);
+            sync_cpus();
+            if (my_cpu == master_cpu) {
+                check_counters(lines, num_cpus);
+            }
+
+            pass_token(lines, cpu_index, num_cpus);
+            sync_cpus();
+
+            if (my_cpu == master_cpu) {
+                uint64_t elapsed = get_time_us() - start_time;
+                uint64_t transfers = (uint64_t)num_cpus * (INCREMENTS_PER_TICK + HANDOFFS_PER_TICK);
+                if (elapsed > 0) {
+                    display_test_stage_description("shared lines, %iK transfers/s",
+                                                   (int)(transfers * 1000 / elapsed));
+                }
+            }
+        }
+        do_tick(my_cpu);
+        BAILOUT;
+    }
+
+    return ticks;
+}
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: GPL-2.0
+// Keeps the memory bus fully loaded for a fixed time by copying blocks of
+// memory between randomly chosen locations. Each CPU divides its chunk of
+// each segment into blocks, the last word of each block holding a CRC32C
+// checksum of the rest of the block, and fills them with random data. It
+// then repeatedly chooses a random source and destination block, copies the
+// inverse of the source data to the destination while checking the source
+// checksum, and then reads back the destination to check its checksum. If
+// the destination is corrupt, it is compared with the source word by word to
+// locate the errors.
+//
+// The blocks are only copied within each CPU's own chunk, never between the
+// chunks of different CPUs, as a block could otherwise be overwritten by one
+// CPU while another was copying or checking it. So the data crossing the bus
+// is random, but the distance it is moved is limited by the chunk size.
+//
+// The test runs for the number of seconds given by the iteration count (set
+// by the copytime boot option), shared between the windows in proportion to
+// the amount of memory in each, so the total time is the same however the
+// memory is split into windows. The copy rate is displayed every second.
+
+#include "common.h"
+#include "unistd.h"
+
+#include "vmem.h"
+
+#include "config.h"
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#include "test_funcs.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define BLOCK_SIZE          (16 * PAGE_SIZE)
+
+#define BLOCK_WORDS         (BLOCK_SIZE / sizeof(testword_t))
+
+#define CRC32C_POLY         0x82f63b78  // reversed
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+#if !defined(__SSE4_2__)
+static uint32_t         crc_table[256];
+static bool             crc_table_valid = false;
+#endif
+
+static volatile uint64_t bytes_copied[MAX_CPUS];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+#if defined(__SSE4_2__)
+
+static inline uint32_t crc32c_word(uint32_t crc, testword_t word)
+{
+#ifdef __LP64__
+    return __builtin_ia32_crc32di(crc, word);
+#else
+    return __builtin_ia32_crc32si(crc, word);
+#endif
+}
+
+static void crc32c_init(void)
+{
+}
+
+#else
+
+static inline uint32_t crc32c_word(uint32_t crc, testword_t word)
+{
+    for (size_t i = 0; i < sizeof(testword_t); i++) {
+        crc = crc_table[(crc ^ word) & 0xff] ^ (crc >> 8);
+        word >>= 8;
+    }
+    return crc;
+}
+
+static void crc32c_init(void)
+{
+    if (crc_table_valid) {
+        return;
+    }
+    for (int i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+        crc_table[i] = crc;
+    }
+    crc_table_valid = true;
+}
+
+#endif
+
+static uintptr_t count_blocks(int my_cpu)
+{
+    uintptr_t num_blocks = 0;
+    for (int i = 0; i < vm_map_size; i++) {
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, BLOCK_SIZE);
+        if (end >= start) {
+            num_blocks += (end - start + 1) / BLOCK_WORDS;
+        }
+    }
+    return num_blocks;
+}
+
+static testword_t *find_block(int my_cpu, uintptr_t n)
+{
+    for (int i = 0; i < vm_map_size; i++) {
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, BLOCK_SIZE);
+        if (end < start) {
+            continue;
+        }
+        uintptr_t num_blocks = (end - start + 1) / BLOCK_WORDS;
+        if (n < num_blocks) {
+            return start + n * BLOCK_WORDS;
+        }
+        n -= num_blocks;
+    }
+    return NULL;
+}
+
+static void fill_block(testword_t *block, testword_t *prsg_state)
+{
+    uint32_t crc = ~0;
+    for (size_t i = 0; i < BLOCK_WORDS - 1; i++) {
+        *prsg_state = prsg(*prsg_state);
+        write_word(&block[i], *prsg_state);
+        crc = crc32c_word(crc, *prsg_state);
+    }
+    write_word(&block[BLOCK_WORDS - 1], ~crc);
+}
+
+static void copy_block(testword_t *src, testword_t *dst)
+{
+    uint32_t src_crc = ~0;
+    uint32_t dst_crc = ~0;
+    for (size_t i = 0; i < BLOCK_WORDS - 1; i++) {
+        testword_t data = read_word(&src[i]);
+        write_word(&dst[i], ~data);
+        src_crc = crc32c_word(src_crc, data);
+        dst_crc = crc32c_word(dst_crc, ~data);
+    }
+    testword_t src_check = read_word(&src[BLOCK_WORDS - 1]);
+    if (unlikely(src_check != (testword_t)~src_crc)) {
+        data_error(&src[BLOCK_WORDS - 1], ~src_crc, src_check, false);
+    }
+    write_word(&dst[BLOCK_WORDS - 1], ~dst_crc);
+
+    uint32_t crc = ~0;
+    for (size_t i = 0; i < BLOCK_WORDS - 1; i++) {
+        crc = crc32c_word(crc, read_word(&dst[i]));
+    }
+    if (crc == dst_crc && read_word(&dst[BLOCK_WORDS - 1]) == (testword_t)~dst_crc) {
+        return;
+    }
+
+    // Locate the errors.
+    for (size_t i = 0; i < BLOCK_WORDS - 1; i++) {
+        testword_t expect = ~read_word(&src[i]);
+        testword_t actual = read_word(&dst[i]);
+        if (unlikely(actual != expect)) {
+            data_error(&dst[i], expect, actual, false);
+        }
+    }
+    testword_t actual = read_word(&dst[BLOCK_WORDS - 1]);
+    if (unlikely(actual != (testword_t)~dst_crc)) {
+        data_error(&dst[BLOCK_WORDS - 1], ~dst_crc, actual, false);
+    }
+}
+
+static uint64_t window_time_us(int iterations)
+{
+    uintptr_t window_pages = 0;
+    for (int i = 0; i < vm_map_size; i++) {
+        window_pages += page_of(vm_map[i].end) - page_of(vm_map[i].start) + 1;
+    }
+    uintptr_t total_pages = (num_pages_to_test > window_pages) ? num_pages_to_test : window_pages;
+    return (uint64_t)iterations * 1000000 * window_pages / total_pages;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+int test_copy_checksum(int my_cpu, int iterations)
+{
+    int ticks = 0;
+
+    uint64_t run_time = window_time_us(iterations);
+
+    // One tick per second or part second.
+    int seconds = (run_time + 999999) / 1000000;
+    if (seconds < 1) {
+        seconds = 1;
+    }
+    if (my_cpu < 0) {
+        return seconds;
+    }
+
+    if (my_cpu == master_cpu) {
+        crc32c_init();
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+            bytes_copied[cpu] = 0;
+        }
+        display_test_stage_description("copying for %i.%02i seconds", (int)(run_time / 1000000), (int)(run_time % 1000000) / 10000);
+    }
+    flush_caches(my_cpu);
+
+    testword_t prsg_state = get_time_us();
+    prsg_state *= 0x12345678;
+    prsg_state += my_cpu + 1;
+
+    uintptr_t num_blocks = count_blocks(my_cpu);
+    for (uintptr_t n = 0; n < num_blocks; n++) {
+        test_addr[my_cpu] = (uintptr_t)find_block(my_cpu, n);
+        fill_block((testword_t *)test_addr[my_cpu], &prsg_state);
+    }
+
+    uint64_t start_time = get_time_us();
+    uint64_t end_time   = start_time + run_time;
+    uint64_t last_bytes = 0;
+    uint64_t last_time  = start_time;
+    for (int i = 0; i < seconds; i++) {
+        uint64_t tick_time = start_time + (uint64_t)(i + 1) * 1000000;
+        if (tick_time > end_time) {
+            tick_time = end_time;
+        }
+        do {
+            if (num_blocks < 2) {
+                usleep(1000);
+                continue;
+            }
+            prsg_state = prsg(prsg_state);
+            uintptr_t src_num = prsg_state % num_blocks;
+            uintptr_t dst_num = (src_num + 1 + (prsg_state >> 16) % (num_blocks - 1)) % num_blocks;
+            testword_t *src = find_block(my_cpu, src_num);
+            testword_t *dst = find_block(my_cpu, dst_num);
+            test_addr[my_cpu] = (uintptr_t)dst;
+            copy_block(src, dst);
+            bytes_copied[my_cpu] += BLOCK_SIZE;
+        } while (get_time_us() < tick_time);
+
+        if (my_cpu == master_cpu) {
+            uint64_t total_bytes = 0;
+            for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+                total_bytes += bytes_copied[cpu];
+            }
+            // Bytes per microsecond to hundredths of a GB per second.
+            uint64_t elapsed = (tick_time > last_time) ? tick_time - last_time : 1;
+            int rate = (total_bytes - last_bytes) / (elapsed * 10);
+            display_test_stage_description("copying, %i.%02i GB/s", rate / 100, rate % 100);
+            last_bytes = total_bytes;
+            last_time  = tick_time;
+        }
+        ticks++;
+        do_tick(my_cpu);
+        BAILOUT;
+    }
+
+    return ticks;
+}
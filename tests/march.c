@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0
+// Implements a generic March test. A March algorithm is a sequence of March
+// elements, each of which applies a short sequence of read and write
+// operations to every word in turn, in ascending or descending address
+// order. Each element is executed as a single sweep through each CPU's chunk
+// of memory, with all the operations for one word being performed before
+// moving to the next word.
+//
+// The algorithm is given in a compact form of the usual March notation that
+// can be passed on the boot command line. The elements are separated by
+// commas. Each element is an address order ('u' for up, 'd' for down, or 'b'
+// for either) followed by the operations, each being 'r' (read and check) or
+// 'w' (write) followed by '0' or '1'. For example, March C- is
+//
+//     bw0,ur0w1,ur1w0,dr0w1,dr1w0,br0
+//
+// On each iteration, a different data background is used for '0', its
+// inverse being used for '1'.
+//
+// The most common element forms (a single write, and a read followed by a
+// write) have their own sweep loops, the others being interpreted word by
+// word.
+
+#include "common.h"
+
+#include "print.h"
+
+#include "display.h"
+#include "error.h"
+#include "test.h"
+#include "tests.h"
+
+#include "test_funcs.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MAX_MARCH_OPS       8
+
+#define NUM_BACKGROUNDS     4
+
+#define DEFAULT_ALGORITHM   0
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    const char      *name;
+    const char      *notation;
+} march_algorithm_t;
+
+typedef enum {
+    KERNEL_WRITE,               // w
+    KERNEL_READ_WRITE,          // r, w
+    KERNEL_GENERIC
+} march_kernel_t;
+
+typedef struct {
+    bool            down;
+    march_kernel_t  kernel;
+    int             num_ops;
+    bool            write[MAX_MARCH_OPS];
+    testword_t      value[MAX_MARCH_OPS];
+} march_element_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static const march_algorithm_t algorithms[] = {
+    { "March C-",   "bw0,ur0w1,ur1w0,dr0w1,dr1w0,br0"                               },
+    { "MATS+",      "bw0,ur0w1,dr1w0"                                               },
+    { "March X",    "bw0,ur0w1,dr1w0,br0"                                           },
+    { "March Y",    "bw0,ur0w1r1,dr1w0r0,br0"                                       },
+    { "March B",    "bw0,ur0w1r1w0r0w1,ur1w0w1,dr1w0w1w0,dr0w1w0"                   },
+    { "March LR",   "bw0,dr0w1,ur1w0r0w1,ur1w0,ur0w1r1w0,ur0"                       },
+    { "March SS",   "bw0,ur0r0w0r0w1,ur1r1w1r1w0,dr0r0w0r0w1,dr1r1w1r1w0,br0"       },
+};
+
+static const testword_t backgrounds[NUM_BACKGROUNDS] = {
+#if TESTWORD_WIDTH > 32
+    UINT64_C(0x0000000000000000),
+    UINT64_C(0x5555555555555555),
+    UINT64_C(0x3333333333333333),
+    UINT64_C(0x0f0f0f0f0f0f0f0f),
+#else
+    0x00000000,
+    0x55555555,
+    0x33333333,
+    0x0f0f0f0f,
+#endif
+};
+
+static const char   *notation = NULL;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static bool same_name(const char *spec, const char *name)
+{
+    // Ignore case and spaces, so that "marchc-" matches "March C-".
+    while (*name != '\0') {
+        if (*name == ' ') {
+            name++;
+            continue;
+        }
+        char c1 = *spec++;
+        char c2 = *name++;
+        if (c1 >= 'A' && c1 <= 'Z') c1 += 'a' - 'A';
+        if (c2 >= 'A' && c2 <= 'Z') c2 += 'a' - 'A';
+        if (c1 != c2) {
+            return false;
+        }
+    }
+    return *spec == '\0';
+}
+
+// Parses the element starting at *spec, and advances *spec past it and any
+// following comma. Returns false if the element is not valid.
+static bool parse_element(const char **spec, march_element_t *element, testword_t background)
+{
+    const char *s = *spec;
+    switch (*s++) {
+      case 'u':
+      case 'b':
+        element->down = false;
+        break;
+      case 'd':
+        element->down = true;
+        break;
+      default:
+        return false;
+    }
+    element->num_ops  = 0;
+    element->value[1] = 0;
+    while (*s != ',' && *s != '\0') {
+        if (element->num_ops == MAX_MARCH_OPS) {
+            return false;
+        }
+        if (s[0] != 'r' && s[0] != 'w') {
+            return false;
+        }
+        if (s[1] != '0' && s[1] != '1') {
+            return false;
+        }
+        element->write[element->num_ops] = (s[0] == 'w');
+        element->value[element->num_ops] = (s[1] == '0') ? background : ~background;
+        element->num_ops++;
+        s += 2;
+    }
+    if (element->num_ops == 0) {
+        return false;
+    }
+    if (element->num_ops == 1 && element->write[0]) {
+        element->kernel = KERNEL_WRITE;
+    } else if (element->num_ops == 2 && !element->write[0] && element->write[1]) {
+        element->kernel = KERNEL_READ_WRITE;
+    } else {
+        element->kernel = KERNEL_GENERIC;
+    }
+    if (*s == ',') {
+        s++;
+    }
+    *spec = s;
+    return true;
+}
+
+static bool valid_notation(const char *spec)
+{
+    if (*spec == '\0') {
+        return false;
+    }
+    while (*spec != '\0') {
+        march_element_t element;
+        if (!parse_element(&spec, &element, 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void set_description(const char *name)
+{
+    char buffer[sizeof(test_list[MARCH_TEST].description)];
+    sprintk(buffer, sizeof(buffer), "[March test, %s]", name);
+    sprintk(test_list[MARCH_TEST].description, sizeof(buffer), "%-39s", buffer);
+}
+
+static inline void check_word(testword_t *p, testword_t expect)
+{
+    testword_t actual = read_word(p);
+    if (unlikely(actual != expect)) {
+        data_error(p, expect, actual, true);
+    }
+}
+
+static inline void apply_ops(testword_t *p, const march_element_t *element)
+{
+    for (int k = 0; k < element->num_ops; k++) {
+        testword_t value = element->value[k];
+        if (element->write[k]) {
+            write_word(p, value);
+        } else {
+            check_word(p, value);
+        }
+    }
+}
+
+static int sweep_up(int my_cpu, const march_element_t *element)
+{
+    int ticks = 0;
+
+    for (int i = 0; i < vm_map_size; i++) {
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, sizeof(testword_t));
+        if (end < start) SKIP_RANGE(1) // we need at least one word for this test
+
+        testword_t *p  = start;
+        testword_t *pe = start;
+
+        bool at_end = false;
+        do {
+            // take care to avoid pointer overflow
+            if ((end - pe) >= SPIN_SIZE) {
+                pe += SPIN_SIZE - 1;
+            } else {
+                at_end = true;
+                pe = end;
+            }
+            ticks++;
+            if (my_cpu < 0) {
+                continue;
+            }
+            test_addr[my_cpu] = (uintptr_t)p;
+            testword_t v0 = element->value[0];
+            testword_t v1 = element->value[1];
+            switch (element->kernel) {
+              case KERNEL_WRITE:
+                do {
+                    write_word(p, v0);
+                } while (p++ < pe); // test before increment in case pointer overflows
+                break;
+              case KERNEL_READ_WRITE:
+                do {
+                    check_word(p, v0);
+                    write_word(p, v1);
+                } while (p++ < pe); // test before increment in case pointer overflows
+                break;
+              default:
+                do {
+                    apply_ops(p, element);
+                } while (p++ < pe); // test before increment in case pointer overflows
+                break;
+            }
+            do_tick(my_cpu);
+            BAILOUT;
+        } while (!at_end && ++pe); // advance pe to next start point
+    }
+
+    return ticks;
+}
+
+static int sweep_down(int my_cpu, const march_element_t *element)
+{
+    int ticks = 0;
+
+    for (int i = vm_map_size - 1; i >= 0; i--) {
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, sizeof(testword_t));
+        if (end < start) SKIP_RANGE(1) // we need at least one word for this test
+
+        testword_t *p  = end;
+        testword_t *ps = end;
+
+        bool at_start = false;
+        do {
+            // take care to avoid pointer underflow
+            if ((ps - start) >= SPIN_SIZE) {
+                ps -= SPIN_SIZE - 1;
+            } else {
+                at_start = true;
+                ps = start;
+            }
+            ticks++;
+            if (my_cpu < 0) {
+                continue;
+            }
+            test_addr[my_cpu] = (uintptr_t)p;
+            testword_t v0 = element->value[0];
+            testword_t v1 = element->value[1];
+            switch (element->kernel) {
+              case KERNEL_WRITE:
+                do {
+                    write_word(p, v0);
+                } while (p-- > ps); // test before decrement in case pointer overflows
+                break;
+              case KERNEL_READ_WRITE:
+                do {
+                    check_word(p, v0);
+                    write_word(p, v1);
+                } while (p-- > ps); // test before decrement in case pointer overflows
+                break;
+              default:
+                do {
+                    apply_ops(p, element);
+                } while (p-- > ps); // test before decrement in case pointer overflows
+                break;
+            }
+            do_tick(my_cpu);
+            BAILOUT;
+        } while (!at_start && --ps); // advance ps to next start point
+    }
+
+    return ticks;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+bool march_select(const char *spec)
+{
+    if (spec == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); i++) {
+        if (same_name(spec, algorithms[i].name)) {
+            notation = algorithms[i].notation;
+            set_description(algorithms[i].name);
+            return true;
+        }
+    }
+    if (!valid_notation(spec)) {
+        return false;
+    }
+    notation = spec;
+    set_description("custom");
+    return true;
+}
+
+int test_march(int my_cpu, int iterations)
+{
+    int ticks = 0;
+
+    const char *spec = (notation != NULL) ? notation : algorithms[DEFAULT_ALGORITHM].notation;
+
+    for (int i = 0; i < iterations; i++) {
+        testword_t background = backgrounds[i % NUM_BACKGROUNDS];
+        if (my_cpu == master_cpu) {
+            display_test_pattern_value(background);
+        }
+
+        const char *s = spec;
+        int element_num = 0;
+        while (*s != '\0') {
+            march_element_t element;
+            if (!parse_element(&s, &element, background)) {
+                break;
+            }
+            element_num++;
+            if (my_cpu == master_cpu) {
+                display_test_stage_description("element %i", element_num);
+            }
+            flush_caches(my_cpu);
+            if (element.down) {
+                ticks += sweep_down(my_cpu, &element);
+            } else {
+                ticks += sweep_up(my_cpu, &element);
+            }
+            BAILOUT;
+        }
+    }
+
+    return ticks;
+}
@@ -156,6 +156,7 @@ int test_mov_inv_fixed(int my_cpu, int iterations, testword_t pattern1, testword
                 }
                 test_addr[my_cpu] = (uintptr_t)p;
                 do {
+                    prefetch_down(p);
                     testword_t actual = read_word(p);
                     if (unlikely(actual != pattern2)) {
                         data_error(p, pattern2, actual, true);
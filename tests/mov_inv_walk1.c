@@ -141,6 +141,7 @@ int test_mov_inv_walk1(int my_cpu, int iterations, int offset, bool inverse)
                 }
                 test_addr[my_cpu] = (uintptr_t)ps;
                 do {
+                    prefetch_down(p);
                     pattern = pattern >> 1 | pattern << (TESTWORD_WIDTH - 1);  // rotate right
                     testword_t expect = pattern;
                     testword_t actual = read_word(p);
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0
+// A wide word version of the moving inversions test with a shifting pattern.
+// Each access reads or writes a whole wide word (a cache line by default),
+// and the walking bit moves through all the bits of the wide word, so the
+// pattern varies across the whole of each memory burst. Errors are reported
+// for each test word lane of the wide word that differs.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#include "test_funcs.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define WIDE_SPIN_SIZE      (SPIN_SIZE / WIDEWORD_LANES)    // in wide words
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+// Vectors are passed by reference, as the ABI for passing them by value
+// depends on the SIMD extensions enabled.
+static inline void walking_pattern(wideword_t *pattern, int bit, bool inverse)
+{
+    wideword_t value = { 0 };
+    value[bit / TESTWORD_WIDTH] = (testword_t)1 << (bit % TESTWORD_WIDTH);
+    *pattern = inverse ? ~value : value;
+}
+
+static inline void check_wide(wideword_t *p, const wideword_t *expect_p)
+{
+    wideword_t expect = *expect_p;
+    wideword_t actual = read_wide(p);
+    wideword_t diff = actual ^ expect;
+    testword_t any = 0;
+    for (int lane = 0; lane < WIDEWORD_LANES; lane++) {
+        any |= diff[lane];
+    }
+    if (unlikely(any != 0)) {
+        for (int lane = 0; lane < WIDEWORD_LANES; lane++) {
+            if (diff[lane] != 0) {
+                data_error((testword_t *)p + lane, expect[lane], actual[lane], true);
+            }
+        }
+    }
+}
+
+static bool wide_chunk(wideword_t **start, wideword_t **end, int my_cpu, int segment)
+{
+    testword_t *word_start, *word_end;
+    calculate_chunk(&word_start, &word_end, my_cpu, segment, sizeof(wideword_t));
+    if (word_end < word_start) {
+        return false;
+    }
+    *start = (wideword_t *)round_up((uintptr_t)word_start, sizeof(wideword_t));
+    *end   = (wideword_t *)round_down((uintptr_t)(word_end + 1), sizeof(wideword_t)) - 1;
+    return *end >= *start;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+int test_mov_inv_wide(int my_cpu, int iterations, int offset, bool inverse)
+{
+    int ticks = 0;
+
+    if (my_cpu == master_cpu) {
+        wideword_t pattern;
+        walking_pattern(&pattern, offset, inverse);
+        display_test_pattern_value(pattern[offset / TESTWORD_WIDTH]);
+        display_test_stage_description("bit %i of %i", offset, WIDEWORD_WIDTH);
+    }
+
+    int bit = offset;
+
+    // Initialize memory with the initial pattern.
+    for (int i = 0; i < vm_map_size; i++) {
+        wideword_t *start, *end;
+        if (!wide_chunk(&start, &end, my_cpu, i)) SKIP_RANGE(1)  // we need at least one wide word for this test
+
+        wideword_t *p  = start;
+        wideword_t *pe = start;
+
+        bool at_end = false;
+        do {
+            // take care to avoid pointer overflow
+            if ((end - pe) >= WIDE_SPIN_SIZE) {
+                pe += WIDE_SPIN_SIZE - 1;
+            } else {
+                at_end = true;
+                pe = end;
+            }
+            ticks++;
+            if (my_cpu < 0) {
+                continue;
+            }
+            test_addr[my_cpu] = (uintptr_t)p;
+            do {
+                wideword_t pattern;
+                walking_pattern(&pattern, bit, inverse);
+                write_wide(p, pattern);
+                bit = (bit + 1) % WIDEWORD_WIDTH;
+            } while (p++ < pe); // test before increment in case pointer overflows
+            do_tick(my_cpu);
+            BAILOUT;
+        } while (!at_end && ++pe); // advance pe to next start point
+    }
+
+    // Check for initial pattern and then write the complement for each memory location.
+    // Test from bottom up and then from the top down.
+    for (int i = 0; i < iterations; i++) {
+        bool invert = inverse;
+        bit = offset;
+
+        flush_caches(my_cpu);
+
+        for (int j = 0; j < vm_map_size; j++) {
+            wideword_t *start, *end;
+            if (!wide_chunk(&start, &end, my_cpu, j)) SKIP_RANGE(1)  // we need at least one wide word for this test
+
+            wideword_t *p  = start;
+            wideword_t *pe = start;
+
+            bool at_end = false;
+            do {
+                // take care to avoid pointer overflow
+                if ((end - pe) >= WIDE_SPIN_SIZE) {
+                    pe += WIDE_SPIN_SIZE - 1;
+                } else {
+                    at_end = true;
+                    pe = end;
+                }
+                ticks++;
+                if (my_cpu < 0) {
+                    continue;
+                }
+                test_addr[my_cpu] = (uintptr_t)p;
+                do {
+                    wideword_t expect;
+                    walking_pattern(&expect, bit, invert);
+                    check_wide(p, &expect);
+                    write_wide(p, ~expect);
+                    bit = (bit + 1) % WIDEWORD_WIDTH;
+                } while (p++ < pe); // test before increment in case pointer overflows
+                do_tick(my_cpu);
+                BAILOUT;
+            } while (!at_end && ++pe); // advance pe to next start point
+        }
+
+        invert = !invert;
+
+        flush_caches(my_cpu);
+
+        for (int j = vm_map_size - 1; j >= 0; j--) {
+            wideword_t *start, *end;
+            if (!wide_chunk(&start, &end, my_cpu, j)) SKIP_RANGE(1)  // we need at least one wide word for this test
+
+            wideword_t *p  = end;
+            wideword_t *ps = end;
+
+            bool at_start = false;
+            do {
+                // take care to avoid pointer underflow
+                if ((ps - start) >= WIDE_SPIN_SIZE) {
+                    ps -= WIDE_SPIN_SIZE - 1;
+                } else {
+                    at_start = true;
+                    ps = start;
+                }
+                ticks++;
+                if (my_cpu < 0) {
+                    continue;
+                }
+                test_addr[my_cpu] = (uintptr_t)ps;
+                do {
+                    prefetch_down(p);
+                    bit = (bit + WIDEWORD_WIDTH - 1) % WIDEWORD_WIDTH;
+                    wideword_t expect;
+                    walking_pattern(&expect, bit, invert);
+                    check_wide(p, &expect);
+                    write_wide(p, ~expect);
+                } while (p-- > ps); // test before decrement in case pointer overflows
+                do_tick(my_cpu);
+                BAILOUT;
+            } while (!at_start && --ps); // advance ps to next start point
+        }
+    }
+
+    return ticks;
+}
@@ -38,8 +38,9 @@ static int pattern_fill(int my_cpu, testword_t offset)
 
     // Write each address with it's own address.
     for (int i = 0; i < vm_map_size; i++) {
-        testword_t *start = vm_map[i].start;
-        testword_t *end   = vm_map[i].end;
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, sizeof(testword_t));
+        if (end < start) SKIP_RANGE(1)  // we need at least one word for this test
 
         testword_t *p  = start;
         testword_t *pe = start;
@@ -77,8 +78,9 @@ static int pattern_check(int my_cpu, testword_t offset)
 
     // Check each address has its own address.
     for (int i = 0; i < vm_map_size; i++) {
-        testword_t *start = vm_map[i].start;
-        testword_t *end   = vm_map[i].end;
+        testword_t *start, *end;
+        calculate_chunk(&start, &end, my_cpu, i, sizeof(testword_t));
+        if (end < start) SKIP_RANGE(1)  // we need at least one word for this test
 
         testword_t *p  = start;
         testword_t *pe = start;
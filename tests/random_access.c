@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0
+// Visits the cache lines in each CPU's chunk of each segment in a random
+// order, so that most accesses open a new DRAM row and miss in the TLB. The
+// order is given by a pseudo-random bijection on the smallest power of two
+// that covers the number of lines, so no table of line numbers is needed;
+// values that lie beyond the last line are simply skipped. Several lines are
+// visited at once, so that the accesses can be overlapped.
+//
+// Each iteration writes each line with a value derived from the address of
+// each word and a random pattern, and then checks each line, visiting them in
+// a different random order. The random access rate is displayed.
+
+#include "common.h"
+#include "unistd.h"
+
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#include "test_funcs.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define LINE_WORDS          (CACHE_LINE_SIZE / sizeof(testword_t))
+
+#define LINES_PER_TICK      (SPIN_SIZE / LINE_WORDS)
+
+#define NUM_CHAINS          4
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uintptr_t       mask;
+    uintptr_t       mul1;
+    uintptr_t       add;
+    uintptr_t       mul2;
+    int             shift;
+} permutation_t;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void init_permutation(permutation_t *perm, uintptr_t num_lines, testword_t *prsg_state)
+{
+    int bits = 0;
+    while (((uintptr_t)1 << bits) < num_lines) {
+        bits++;
+    }
+    perm->mask  = ((uintptr_t)1 << bits) - 1;
+    perm->shift = (bits + 1) / 2 + 1;
+    *prsg_state = prsg(*prsg_state);
+    perm->mul1  = *prsg_state | 1;
+    *prsg_state = prsg(*prsg_state);
+    perm->add   = *prsg_state;
+    *prsg_state = prsg(*prsg_state);
+    perm->mul2  = *prsg_state | 1;
+}
+
+// Each step is a bijection on the numbers 0 to mask, so the composition is.
+static inline uintptr_t permute(const permutation_t *perm, uintptr_t x)
+{
+    x = (x * perm->mul1 + perm->add) & perm->mask;
+    x ^= x >> perm->shift;
+    x = (x * perm->mul2) & perm->mask;
+    return x;
+}
+
+static int permuted_pass(int my_cpu, testword_t *start, uintptr_t num_lines, const permutation_t *perm,
+                         testword_t pattern, bool check)
+{
+    int ticks = 0;
+
+    uintptr_t range = perm->mask + 1;
+    uintptr_t i = 0;
+    do {
+        uintptr_t i_end = (range - i > LINES_PER_TICK) ? i + LINES_PER_TICK : range;
+        ticks++;
+        if (my_cpu < 0) {
+            i = i_end;
+            continue;
+        }
+        test_addr[my_cpu] = (uintptr_t)start;
+        for (; i < i_end; i += NUM_CHAINS) {
+            testword_t *line[NUM_CHAINS];
+            for (int c = 0; c < NUM_CHAINS; c++) {
+                uintptr_t n = permute(perm, i + c);
+                line[c] = (i + c < range && n < num_lines) ? start + n * LINE_WORDS : NULL;
+            }
+            for (int c = 0; c < NUM_CHAINS; c++) {
+                testword_t *p = line[c];
+                if (p == NULL) {
+                    continue;
+                }
+                for (size_t w = 0; w < LINE_WORDS; w++, p++) {
+                    testword_t expect = (testword_t)(uintptr_t)p ^ pattern;
+                    if (check) {
+                        testword_t actual = read_word(p);
+                        if (unlikely(actual != expect)) {
+                            data_error(p, expect, actual, true);
+                        }
+                    } else {
+                        write_word(p, expect);
+                    }
+                }
+            }
+        }
+        do_tick(my_cpu);
+        BAILOUT;
+    } while (i < range);
+
+    return ticks;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+int test_random_access(int my_cpu, int iterations)
+{
+    int ticks = 0;
+
+    testword_t prsg_state = io_read(AM_TIMER_UPTIME).us;
+    prsg_state *= 0x87654321;
+    prsg_state += my_cpu + 1;
+
+    for (int iter = 0; iter < iterations; iter++) {
+        prsg_state = prsg(prsg_state);
+        testword_t pattern = prsg_state;
+
+        uint64_t start_time = get_time_us();
+        uint64_t num_bytes  = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            bool check = (pass == 1);
+            for (int i = 0; i < vm_map_size; i++) {
+                testword_t *start, *end;
+                calculate_chunk(&start, &end, my_cpu, i, CACHE_LINE_SIZE);
+                if (end < start) SKIP_RANGE(1)  // we need at least one line for this test
+
+                uintptr_t num_lines = (end - start + 1) / LINE_WORDS;
+                if (num_lines == 0) SKIP_RANGE(1)
+
+                permutation_t perm;
+                init_permutation(&perm, num_lines, &prsg_state);
+                ticks += permuted_pass(my_cpu, start, num_lines, &perm, pattern, check);
+                BAILOUT;
+                num_bytes += num_lines * CACHE_LINE_SIZE;
+            }
+            flush_caches(my_cpu);
+        }
+
+        if (my_cpu == master_cpu) {
+            uint64_t elapsed = get_time_us() - start_time;
+            if (elapsed > 0) {
+                // Bytes per microsecond to hundredths of a GB per second.
+                int rate = num_bytes * num_active_cpus * 100 / (elapsed * 1000);
+                display_test_stage_description("random access, %i.%02i GB/s", rate / 100, rate % 100);
+            }
+        }
+    }
+
+    return ticks;
+}
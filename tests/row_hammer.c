@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: GPL-2.0
+// Tests for disturbance errors (row hammer). Repeatedly activating a DRAM row
+// can flip bits in the physically adjacent rows of the same bank if they are
+// not refreshed in time. The row and bank of an address are determined by its
+// physical address bits. Without knowledge of the memory controller address
+// mapping, we assume that the bits below ROW_SHIFT select the channel, bank,
+// and column, and the bits above select the row, so two addresses that differ
+// only by a multiple of the row size are in different rows of the same bank.
+//
+// Each CPU fills its chunk of each segment with alternating row stripes of a
+// random pattern and its inverse. It then takes each row in turn as the victim,
+// and hammers the pair of aggressor rows either side of it at the same column
+// offset, reading each aggressor and flushing it from the cache so that every
+// read activates the row. Each pair is hammered for at most one refresh
+// window. Finally, the whole chunk is checked, so errors induced in rows that
+// are adjacent under a different address mapping are also found. Each
+// iteration uses a different column offset. The activation rate achieved is
+// displayed.
+//
+// Where the CPU has no instruction to flush a single cache line, most reads
+// would be satisfied by the cache and would not activate the row, so the test
+// is not supported and is skipped.
+
+#include "common.h"
+#include "unistd.h"
+
+#include "cache.h"
+#include "vmem.h"
+
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#include "test_funcs.h"
+#include "test_helper.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#ifndef ROW_SHIFT
+#define ROW_SHIFT           18      // 8KB pages x 16 banks x 2 channels
+#endif
+
+#define ROW_SIZE            ((uintptr_t)1 << ROW_SHIFT)
+
+#define ROW_WORDS           (ROW_SIZE / sizeof(testword_t))
+
+#define CHECK_ROWS_PER_TICK (SPIN_SIZE / ROW_WORDS)
+
+#define HAMMER_ROWS_PER_TICK 16
+
+#define HAMMER_READS        (1 << 18)   // per aggressor
+
+#define HAMMER_BATCH        (1 << 12)   // reads between timer checks
+
+#define REFRESH_WINDOW_US   64000
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static volatile uint64_t activations[MAX_CPUS];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+#if CACHE_FLUSH_LINE
+
+static inline testword_t row_value(const testword_t *row, testword_t pattern)
+{
+    uintptr_t row_num = page_of((void *)row) >> (ROW_SHIFT - PAGE_SHIFT);
+    return (row_num & 1) ? ~pattern : pattern;
+}
+
+// Finds the whole rows in my_cpu's chunk of segment. Returns the number found.
+static uintptr_t row_chunk(testword_t **start, int my_cpu, int segment)
+{
+    testword_t *word_start, *word_end;
+    calculate_chunk(&word_start, &word_end, my_cpu, segment, ROW_SIZE);
+    if (word_end < word_start) {
+        return 0;
+    }
+    uintptr_t first = round_up((uintptr_t)word_start, ROW_SIZE);
+    uintptr_t last  = round_down((uintptr_t)(word_end + 1), ROW_SIZE);
+    if (last <= first) {
+        return 0;
+    }
+    *start = (testword_t *)first;
+    return (last - first) / ROW_SIZE;
+}
+
+// Reads each aggressor in turn, evicting it from the cache so that the next
+// read activates the row again. Returns the number of reads of each aggressor.
+static int hammer_pair(const testword_t *aggr1, const testword_t *aggr2)
+{
+    uint64_t start_time = get_time_us();
+    int reads = 0;
+    while (reads < HAMMER_READS) {
+        for (int i = 0; i < HAMMER_BATCH; i++) {
+            (void)read_word(aggr1);
+            (void)read_word(aggr2);
+            cache_flush_line(aggr1);
+            cache_flush_line(aggr2);
+            cache_flush_wait();
+        }
+        reads += HAMMER_BATCH;
+        if (get_time_us() - start_time >= REFRESH_WINDOW_US) {
+            break;
+        }
+    }
+    return reads;
+}
+
+static int fill_rows(int my_cpu, testword_t pattern)
+{
+    int ticks = 0;
+
+    for (int i = 0; i < vm_map_size; i++) {
+        testword_t *start;
+        uintptr_t num_rows = row_chunk(&start, my_cpu, i);
+        if (num_rows < 3) SKIP_RANGE(1)  // we need at least one victim and two aggressors
+
+        uintptr_t row = 0;
+        do {
+            uintptr_t row_end = (num_rows - row > CHECK_ROWS_PER_TICK) ? row + CHECK_ROWS_PER_TICK : num_rows;
+            ticks++;
+            if (my_cpu < 0) {
+                row = row_end;
+                continue;
+            }
+            test_addr[my_cpu] = (uintptr_t)(start + row * ROW_WORDS);
+            for (; row < row_end; row++) {
+                testword_t *p  = start + row * ROW_WORDS;
+                testword_t *pe = p + ROW_WORDS;
+                testword_t value = row_value(p, pattern);
+                do {
+                    write_word(p, value);
+                } while (++p < pe);
+            }
+            do_tick(my_cpu);
+            BAILOUT;
+        } while (row < num_rows);
+    }
+
+    return ticks;
+}
+
+static int hammer_rows(int my_cpu, uintptr_t column)
+{
+    int ticks = 0;
+
+    for (int i = 0; i < vm_map_size; i++) {
+        testword_t *start;
+        uintptr_t num_rows = row_chunk(&start, my_cpu, i);
+        if (num_rows < 3) SKIP_RANGE(1)  // we need at least one victim and two aggressors
+
+        uintptr_t victim = 1;
+        do {
+            uintptr_t victim_end = (num_rows - 1 - victim > HAMMER_ROWS_PER_TICK) ? victim + HAMMER_ROWS_PER_TICK : num_rows - 1;
+            ticks++;
+            if (my_cpu < 0) {
+                victim = victim_end;
+                continue;
+            }
+            for (; victim < victim_end; victim++) {
+                testword_t *aggr1 = start + (victim - 1) * ROW_WORDS + column;
+                testword_t *aggr2 = start + (victim + 1) * ROW_WORDS + column;
+                test_addr[my_cpu] = (uintptr_t)(start + victim * ROW_WORDS);
+                activations[my_cpu] += 2 * hammer_pair(aggr1, aggr2);
+            }
+            do_tick(my_cpu);
+            BAILOUT;
+        } while (victim < num_rows - 1);
+    }
+
+    return ticks;
+}
+
+static int check_rows(int my_cpu, testword_t pattern)
+{
+    int ticks = 0;
+
+    for (int i = 0; i < vm_map_size; i++) {
+        testword_t *start;
+        uintptr_t num_rows = row_chunk(&start, my_cpu, i);
+        if (num_rows < 3) SKIP_RANGE(1)  // we need at least one victim and two aggressors
+
+        uintptr_t row = 0;
+        do {
+            uintptr_t row_end = (num_rows - row > CHECK_ROWS_PER_TICK) ? row + CHECK_ROWS_PER_TICK : num_rows;
+            ticks++;
+            if (my_cpu < 0) {
+                row = row_end;
+                continue;
+            }
+            test_addr[my_cpu] = (uintptr_t)(start + row * ROW_WORDS);
+            for (; row < row_end; row++) {
+                testword_t *p  = start + row * ROW_WORDS;
+                testword_t *pe = p + ROW_WORDS;
+                testword_t expect = row_value(p, pattern);
+                do {
+                    testword_t actual = read_word(p);
+                    if (unlikely(actual != expect)) {
+                        data_error(p, expect, actual, true);
+                    }
+                } while (++p < pe);
+            }
+            do_tick(my_cpu);
+            BAILOUT;
+        } while (row < num_rows);
+    }
+
+    return ticks;
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+int test_row_hammer(int my_cpu, int iterations)
+{
+    int ticks = 0;
+
+#if !CACHE_FLUSH_LINE
+    (void)iterations;
+
+    if (my_cpu == master_cpu) {
+        display_test_stage_description("not supported, no cache line flush");
+    }
+#else
+    testword_t prsg_state = get_time_us();
+    prsg_state *= 0x13579bdf;
+    prsg_state += my_cpu + 1;
+
+    for (int iter = 0; iter < iterations; iter++) {
+        // All CPUs use the same pattern, so that the stripes are continuous.
+        testword_t pattern = prsg(0x9e3779b9 + iter);
+        if (my_cpu == master_cpu) {
+            display_test_pattern_value(pattern);
+        }
+
+        ticks += fill_rows(my_cpu, pattern);
+        BAILOUT;
+
+        prsg_state = prsg(prsg_state);
+        uintptr_t column = round_down(prsg_state % ROW_SIZE, CACHE_LINE_SIZE) / sizeof(testword_t);
+
+        if (my_cpu == master_cpu) {
+            for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+                activations[cpu] = 0;
+            }
+            display_test_stage_description("hammering column %i", (int)(column * sizeof(testword_t)));
+        }
+        flush_caches(my_cpu);
+
+        uint64_t start_time = get_time_us();
+        ticks += hammer_rows(my_cpu, column);
+        BAILOUT;
+
+        flush_caches(my_cpu);
+
+        if (my_cpu == master_cpu) {
+            uint64_t elapsed = get_time_us() - start_time;
+            uint64_t total = 0;
+            for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+                total += activations[cpu];
+            }
+            if (elapsed > 0) {
+                // Activations per microsecond to thousands per second.
+                int rate = total * 1000 / elapsed;
+                display_test_stage_description("hammered, %iK activations/s", rate);
+            }
+        }
+
+        ticks += check_rows(my_cpu, pattern);
+        BAILOUT;
+    }
+#endif
+
+    return ticks;
+}
@@ -33,4 +33,18 @@ int test_block_move(int my_cpu, int iterations);
 
 int test_bit_fade(int my_cpu, int stage, int sleep_secs);
 
+int test_cache_sets(int my_cpu, int stage, int iterations);
+
+int test_coherency(int my_cpu, int iterations);
+
+int test_copy_checksum(int my_cpu, int iterations);
+
+int test_random_access(int my_cpu, int iterations);
+
+int test_march(int my_cpu, int iterations);
+
+int test_mov_inv_wide(int my_cpu, int iterations, int offset, bool inverse);
+
+int test_row_hammer(int my_cpu, int iterations);
+
 #endif // TEST_FUNCS_H
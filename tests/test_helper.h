@@ -11,9 +11,12 @@
  * Copyright (C) 2020-2022 Martin Whitaker.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "cache.h"
+#include "cpuinfo.h"
 #include "test.h"
 
 /**
@@ -29,6 +32,72 @@
 #define write_word  write32
 #endif
 
+/**
+ * Test word read and write functions that bypass the CPU caches. The write
+ * is flushed to memory before returning, and the read is preceded by a flush
+ * of any cached copy. If the CPU has no cache line flush instruction (see
+ * CACHE_FLUSH_LINE), these are the same as read_word and write_word, and the
+ * caller must disable the caches instead.
+ */
+static inline testword_t read_word_uncached(testword_t *p)
+{
+    cache_flush_line(p);
+    cache_flush_wait();
+    return read_word(p);
+}
+
+static inline void write_word_uncached(testword_t *p, testword_t value)
+{
+    write_word(p, value);
+    cache_flush_line(p);
+    cache_flush_wait();
+}
+
+/**
+ * Wide word read and write functions. Each accesses the whole wide word, in
+ * a single access where the CPU supports it. When simulating faults, a wide
+ * word in the range containing the simulated faults is accessed one test word
+ * at a time, so that the accesses pass through the faulty memory model.
+ */
+#ifdef FAULT_SIM
+static inline bool wide_in_faultsim_range(const wideword_t *p)
+{
+    return faultsim_in_range((uintptr_t)p) || faultsim_in_range((uintptr_t)(p + 1) - 1);
+}
+
+static inline void faultsim_read_wide(const wideword_t *p, wideword_t *value)
+{
+    if (!wide_in_faultsim_range(p)) {
+        faultsim_bytes += sizeof(wideword_t);
+        *value = *(const volatile wideword_t *)p;
+        return;
+    }
+    for (int lane = 0; lane < WIDEWORD_LANES; lane++) {
+        (*value)[lane] = read_word((const testword_t *)p + lane);
+    }
+}
+
+static inline void faultsim_write_wide(wideword_t *p, const wideword_t *value)
+{
+    if (!wide_in_faultsim_range(p)) {
+        faultsim_bytes += sizeof(wideword_t);
+        *(volatile wideword_t *)p = *value;
+        return;
+    }
+    for (int lane = 0; lane < WIDEWORD_LANES; lane++) {
+        write_word((testword_t *)p + lane, (*value)[lane]);
+    }
+}
+
+// The values are passed by pointer, as passing a wide word by value changes
+// the ABI depending on the vector extensions enabled.
+#define read_wide(p)        ({ wideword_t _v; faultsim_read_wide((p), &_v); _v; })
+#define write_wide(p, v)    ({ wideword_t _v = (v); faultsim_write_wide((p), &_v); })
+#else
+#define read_wide(p)        (*(const volatile wideword_t *)(p))
+#define write_wide(p, v)    (*(volatile wideword_t *)(p) = (v))
+#endif
+
 /**
  * A wrapper for guiding branch prediction.
  */
@@ -41,6 +110,23 @@
  */
 #define SPIN_SIZE (1 << 27)  // in testwords
 
+/**
+ * The CPU cache line size assumed by the tests that target the caches.
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * Issues a software prefetch for the cache line prefetch_distance bytes below
+ * p, if p is at the start of a cache line. Used by the top-down sweeps, which
+ * the CPU hardware prefetchers may follow less well than bottom-up sweeps.
+ */
+static inline void prefetch_down(const void *p)
+{
+    if (prefetch_distance != 0 && ((uintptr_t)p & (CACHE_LINE_SIZE - 1)) == 0) {
+        __builtin_prefetch((const void *)((uintptr_t)p - prefetch_distance), 1);
+    }
+}
+
 /**
  * A macro to perform test bailout when requested.
  */
@@ -20,6 +20,7 @@
 #include "test_funcs.h"
 #include "test_helper.h"
 #include "tests.h"
+#include "trace.h"
 
 //------------------------------------------------------------------------------
 // Constants
@@ -37,9 +38,9 @@
 
 test_pattern_t test_list[NUM_TEST_PATTERNS] = {
     // ena,  cpu, stgs, itrs, errs, description
-    { true,  SEQ,    1,    6,    0, "[Address test, walking ones, no cache] "},
-    {false,  SEQ,    1,    6,    0, "[Address test, own address in window]  "},
-    { true,  SEQ,    2,    6,    0, "[Address test, own address + window]   "},
+    { true,  PAR,    1,    6,    0, "[Address test, walking ones, no cache] "},
+    {false,  PAR,    1,    6,    0, "[Address test, own address in window]  "},
+    { true,  PAR,    2,    6,    0, "[Address test, own address + window]   "},
     { true,  PAR,    1,    6,    0, "[Moving inversions, 1s & 0s]           "},
     { true,  PAR,    1,    3,    0, "[Moving inversions, 8 bit pattern]     "},
     { true,  PAR,    1,   30,    0, "[Moving inversions, random pattern]    "},
@@ -51,7 +52,21 @@ test_pattern_t test_list[NUM_TEST_PATTERNS] = {
     { true,  PAR,    1,   81,    0, "[Block move]                           "},
     { true,  PAR,    1,   48,    0, "[Random number sequence]               "},
     { true,  PAR,    1,    6,    0, "[Modulo 20, random pattern]            "},
-    { true,  ONE,    6,  240,    0, "[Bit fade test, 2 patterns]            "},
+    { true,  PAR,    6,  240,    0, "[Bit fade test, 2 patterns]            "},
+    { true,  PAR,    3,   60,    0, "[Cache working sets, L1/L2/L3]         "},
+    { true,  PAR,    1,    6,    0, "[Cache coherency, shared lines]        "},
+    { true,  PAR,    1,   30,    0, "[Copy and checksum, random blocks]     "},
+    { true,  PAR,    1,    3,    0, "[Random access, permuted lines]        "},
+    { true,  PAR,    1,    4,    0, "[March test, March C-]                 "},
+#if WIDEWORD_WIDTH > 256
+    { true,  PAR,    1,    2,    0, "[Moving inversions, 512 bit pattern]   "},
+#elif WIDEWORD_WIDTH > 128
+    { true,  PAR,    1,    2,    0, "[Moving inversions, 256 bit pattern]   "},
+#else
+    { true,  PAR,    1,    2,    0, "[Moving inversions, 128 bit pattern]   "},
+#endif
+    // Disabled by default, as it takes minutes per GB.
+    {false,  PAR,    1,    1,    0, "[Row hammer, adjacent row pairs]       "},
 };
 
 int ticks_per_pass[NUM_PASS_TYPES];
@@ -103,9 +118,13 @@ int run_test(int my_cpu, int test, int stage, int iterations)
     switch (test) {
         // Address test, walking ones.
       case 0:
+#if !CACHE_FLUSH_LINE
         if (my_cpu >= 0) cache_off();
+#endif
         ticks += test_addr_walk1(my_cpu);
+#if !CACHE_FLUSH_LINE
         if (my_cpu >= 0) cache_on();
+#endif
         BAILOUT;
         break;
 
@@ -230,6 +249,69 @@ int run_test(int my_cpu, int test, int stage, int iterations)
         ticks += test_bit_fade(my_cpu, stage, iterations);
         BAILOUT;
         break;
+
+        // Cache working sets.
+      case 11: {
+        // The working sets don't depend on the window, so only test them in
+        // the first window that contains memory to test.
+        bool first_window = (windows_tested == 0);
+        BARRIER;
+        if (first_window) {
+            ticks += test_cache_sets(my_cpu, stage, iterations);
+            BAILOUT;
+        }
+      } break;
+
+        // Cache coherency, shared lines.
+      case 12: {
+        // The shared lines don't depend on the window either.
+        bool first_window = (windows_tested == 0);
+        BARRIER;
+        if (first_window) {
+            ticks += test_coherency(my_cpu, iterations);
+            BAILOUT;
+        }
+      } break;
+
+        // Copy and checksum, random blocks.
+      case 13:
+        ticks += test_copy_checksum(my_cpu, iterations);
+        BAILOUT;
+        break;
+
+        // Random access, permuted lines.
+      case 14:
+        ticks += test_random_access(my_cpu, iterations);
+        BAILOUT;
+        break;
+
+        // March test.
+      case 15:
+        ticks += test_march(my_cpu, iterations);
+        BAILOUT;
+        break;
+
+        // Moving inversions, wide word shifting pattern.
+      case 16:
+        for (int lane = 0; lane < WIDEWORD_LANES; lane++) {
+            // Start in a different lane and bit each time.
+            int offset = lane * (TESTWORD_WIDTH + 1);
+
+            BARRIER;
+            ticks += test_mov_inv_wide(my_cpu, iterations, offset, false);
+            BAILOUT;
+
+            BARRIER;
+            ticks += test_mov_inv_wide(my_cpu, iterations, offset, true);
+            BAILOUT;
+        }
+        break;
+
+        // Row hammer, adjacent row pairs.
+      case 17:
+        ticks += test_row_hammer(my_cpu, iterations);
+        BAILOUT;
+        break;
     }
     return ticks;
 }
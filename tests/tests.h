@@ -14,7 +14,11 @@
 
 #include "config.h"
 
-#define NUM_TEST_PATTERNS   11
+#define NUM_TEST_PATTERNS   18
+
+#define BIT_FADE_TEST       10
+#define COPY_TEST           13
+#define MARCH_TEST          15
 
 typedef struct {
     bool            enabled;
@@ -34,4 +38,6 @@ extern int ticks_per_test[NUM_PASS_TYPES][NUM_TEST_PATTERNS];
 
 int run_test(int my_cpu, int test, int stage, int iterations);
 
+bool march_select(const char *spec);
+
 #endif // TESTS_H